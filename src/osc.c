@@ -1,20 +1,36 @@
 #include "osc.h"
+#include "osc_pool.h"
 
 #include <string.h>
 
 // ============================================================================
 
+// Arena memory when given, pool or heap otherwise
+static void* osc_object_alloc (OscArena* arena, size_t size) {
+    return arena ? osc_arena_alloc(arena, size) : osc_pool_alloc(size);
+}
+
+// ============================================================================
+
 char* osc_strdup (const char* str) {
+    return osc_strdup_ex(NULL, str);
+}
+
+char* osc_strdup_ex (OscArena* arena, const char* str) {
     size_t len = strlen(str);
-    char*  res = (char*)osc_malloc(len + 1);
+    char*  res = (char*)osc_arena_alloc(arena, len + 1);
 
-    strcpy(res, str);
+    memcpy(res, str, len + 1);
     return res;
 }
 
 // ============================================================================
 
 OscMessage* osc_message_create (const char* tags) {
+    return osc_message_create_ex(NULL, tags);
+}
+
+OscMessage* osc_message_create_ex (OscArena* arena, const char* tags) {
 
     // Tag string cannot be NULL
     if (tags == NULL) {
@@ -22,15 +38,17 @@ OscMessage* osc_message_create (const char* tags) {
     }
 
     // Allocate the message
-    OscMessage* msg = (OscMessage*)osc_malloc(sizeof(OscMessage));
+    OscMessage* msg = (OscMessage*)osc_object_alloc(arena, sizeof(OscMessage));
     msg->addr = NULL;
-    msg->tags = osc_strdup(tags);
+    msg->tags = osc_pool_strdup(arena, tags);
     msg->next = NULL;
 
+    msg->num_args = strlen(tags);
+
     // Allocate & clear args
-    size_t asize = sizeof(OscArgument) * strlen(tags);
+    size_t asize = sizeof(OscArgument) * msg->num_args;
     if (asize) {
-        msg->args = (OscArgument*)osc_malloc(asize);
+        msg->args = (OscArgument*)osc_object_alloc(arena, asize);
         memset((void*)msg->args, 0, asize);
     }
     else {
@@ -50,30 +68,30 @@ OscMessage* osc_message_delete (const OscMessage* msg) {
     if (msg->args) {
 
         if (msg->tags) {
-            for (size_t i=0; i<strlen(msg->tags); ++i) {
+            for (size_t i=0; i<msg->num_args; ++i) {
                 if (msg->tags[i] == 's' || msg->tags[i] == 'S') {
                     if (msg->args[i].str) {
-                        osc_free((void*)msg->args[i].str);
+                        osc_pool_free((void*)msg->args[i].str);
                     }
                 }
             }
         }
 
-        osc_free((void*)msg->args);
+        osc_pool_free((void*)msg->args);
     }
 
     // Free tags string
     if (msg->tags) {
-        osc_free((void*)msg->tags);
+        osc_pool_free((void*)msg->tags);
     }
 
     // Free address string
     if (msg->addr) {
-        osc_free((void*)msg->addr);
+        osc_pool_free((void*)msg->addr);
     }
 
     // Free the message
-    osc_free((void*)msg);
+    osc_pool_free((void*)msg);
 
     return NULL;
 }
@@ -81,8 +99,12 @@ OscMessage* osc_message_delete (const OscMessage* msg) {
 // ============================================================================
 
 OscBundle* osc_bundle_create (int64_t timestamp) {
+    return osc_bundle_create_ex(NULL, timestamp);
+}
+
+OscBundle* osc_bundle_create_ex (OscArena* arena, int64_t timestamp) {
 
-    OscBundle* bundle = (OscBundle*)osc_malloc(sizeof(OscBundle));
+    OscBundle* bundle = (OscBundle*)osc_object_alloc(arena, sizeof(OscBundle));
     bundle->timestamp = timestamp;
     bundle->messages  = NULL;
     bundle->bundles   = NULL;
@@ -112,7 +134,7 @@ OscBundle* osc_bundle_delete (const OscBundle* bundle) {
     }
 
     // Delete self
-    osc_free((void*)bundle);
+    osc_pool_free((void*)bundle);
 
     return NULL;
 }
@@ -27,6 +27,15 @@ typedef union _OscArgument {
         uint8_t data2;
     } midi;
 
+    // Blob, never freed separately. Parsed blobs point into the source
+    // buffer unless parsed with OSC_PARSE_COPY_BLOBS, which stores them in
+    // the argument array allocation. Blobs to encode may point to any caller
+    // memory.
+    struct {
+        const uint8_t*  data;
+        int32_t         size;
+    } blob;
+
     uint8_t b[8];
 
 } OscArgument;
@@ -37,6 +46,7 @@ typedef struct _OscMessage {
     char*           addr;   // Address string
     char*           tags;   // Tag string
     OscArgument*    args;   // Argument array (of length of the tag string)
+    size_t          num_args; // Length of the tag string
 
     struct _OscMessage* next;
 
@@ -55,31 +65,405 @@ typedef struct _OscBundle {
 
 // ============================================================================
 
+// View side table capacities
+#ifndef OSC_VIEW_MAX_BUNDLES
+#define OSC_VIEW_MAX_BUNDLES    16
+#endif
+
+#ifndef OSC_VIEW_MAX_MESSAGES
+#define OSC_VIEW_MAX_MESSAGES   64
+#endif
+
+#ifndef OSC_VIEW_MAX_ARGS
+#define OSC_VIEW_MAX_ARGS       256
+#endif
+
+// Read-only OSC message view. Strings point into the parsed buffer
+typedef struct _OscMessageView {
+
+    const char*         addr;   // Address string
+    const char*         tags;   // Tag string
+    const OscArgument*  args;   // Arguments (in the view argument table)
+    size_t              bundle; // Index of the enclosing bundle
+
+} OscMessageView;
+
+// Read-only OSC bundle view
+typedef struct _OscBundleView {
+
+    int64_t timestamp;  // Timestamp
+    int     parent;     // Index of the parent bundle, -1 for the root
+    size_t  first;      // First message (sub-bundles included)
+    size_t  count;      // Message count (sub-bundles included)
+
+} OscBundleView;
+
+// Parsed packet view. Bundles and messages are stored in wire order
+typedef struct _OscView {
+
+    size_t          num_bundles;
+    size_t          num_messages;
+    size_t          num_args;
+
+    OscBundleView   bundles  [OSC_VIEW_MAX_BUNDLES];
+    OscMessageView  messages [OSC_VIEW_MAX_MESSAGES];
+    OscArgument     args     [OSC_VIEW_MAX_ARGS];
+
+} OscView;
+
+// Parsed packet in a single allocation. Tables are stored in wire order,
+// strings point into a copy of the packet data held in the same block.
+typedef struct _OscPacket {
+
+    size_t              num_bundles;
+    size_t              num_messages;
+    size_t              num_args;
+
+    OscBundleView*      bundles;
+    OscMessageView*     messages;
+    OscArgument*        args;
+
+} OscPacket;
+
+// Validation summary
+typedef struct _OscInfo {
+
+    size_t      num_bundles;    // Bundles, a bare message counts as none
+    size_t      num_messages;
+    size_t      num_args;
+    size_t      depth;          // Bundle nesting depth, 0 for a bare message
+    const char* addr;           // First address, points into the data
+
+} OscInfo;
+
+// ============================================================================
+
 extern void* osc_malloc (size_t size);
 extern void  osc_free   (void* ptr);
 
+// Allocated with osc_malloc() even when a pool is bound, may be released
+// with osc_free() or by deleting the message holding it
 char* osc_strdup (const char* str);
 
 // ============================================================================
 
+// Arena (bump) allocator. Objects allocated from an arena must not be freed
+// or deleted individually, they are all released by osc_arena_reset().
+typedef struct _OscArena OscArena;
+
+OscArena* osc_arena_create  (size_t size);
+OscArena* osc_arena_delete  (OscArena* arena);
+
+void  osc_arena_reset       (OscArena* arena);
+void* osc_arena_alloc       (OscArena* arena, size_t size); // NULL arena uses osc_malloc()
+
+char* osc_strdup_ex         (OscArena* arena, const char* str);
+
+// ============================================================================
+
+// Object pool for messages, bundles, argument arrays and strings. Blocks come
+// in OSC_POOL_CLASSES power of 2 size classes starting at OSC_POOL_MIN_SIZE
+// bytes, carved from one allocation made at creation. Create / delete
+// functions (and the parser without an arena) use the pool bound to the
+// calling thread, falling back to osc_malloc() when it is exhausted (counted
+// as misses). Pooled objects must be deleted on a thread bound to the same
+// pool.
+typedef struct _OscPool OscPool;
+
+#define OSC_POOL_CLASSES    8
+#define OSC_POOL_MIN_SIZE   16
+
+// Block counts per size class
+OscPool* osc_pool_create (const size_t counts[OSC_POOL_CLASSES]);
+OscPool* osc_pool_delete (OscPool* pool);
+
+// Binds the pool to the calling thread (NULL unbinds), returns the previous
+OscPool* osc_pool_bind (OscPool* pool);
+
+size_t osc_pool_used   (const OscPool* pool);
+size_t osc_pool_misses (const OscPool* pool);
+
+// ============================================================================
+
 OscMessage* osc_message_create  (const char* tags);
 OscMessage* osc_message_delete  (const OscMessage* msg);
 
 OscBundle* osc_bundle_create    (int64_t timestamp);
 OscBundle* osc_bundle_delete    (const OscBundle* bundle);
 
+OscMessage* osc_message_create_ex   (OscArena* arena, const char* tags);
+OscBundle*  osc_bundle_create_ex    (OscArena* arena, int64_t timestamp);
+
 void osc_bundle_add_message (OscBundle* bundle, OscMessage* msg);
 void osc_bundle_add_bundle  (OscBundle* bundle, OscBundle* other);
 
 // ============================================================================
 
+// Parse error reasons
+#define OSC_ERR_NONE        0
+#define OSC_ERR_ADDRESS     1   // Missing or unterminated address
+#define OSC_ERR_TAGS        2   // Missing or unterminated tag string
+#define OSC_ERR_ARGUMENT    3   // Truncated or unknown argument, unbalanced array
+#define OSC_ERR_BUNDLE      4   // Bundle header or element size
+#define OSC_ERR_LIMIT       5   // Output table capacity or parser limit
+#define OSC_ERR_SIZE        6   // Unaligned size or trailing bytes (strict mode)
+#define OSC_ERR_COUNT       7
+
+// Parse modes. Lenient accepts what osc_parse() accepts, strict also requires
+// message and bundle element sizes to be multiples of 4 and messages to end
+// with their last argument. OSC_PARSE_COPY_BLOBS may be or-ed in so that
+// trees outlive the source buffer (strings are always copied).
+#define OSC_PARSE_LENIENT       0
+#define OSC_PARSE_STRICT        1
+#define OSC_PARSE_COPY_BLOBS    2
+
+// Parser limits, larger packets are rejected with OSC_ERR_LIMIT
+#ifndef OSC_PARSE_MAX_SIZE
+#define OSC_PARSE_MAX_SIZE      (1 << 20)   // Packet bytes
+#endif
+
+#ifndef OSC_PARSE_MAX_DEPTH
+#define OSC_PARSE_MAX_DEPTH     32          // Bundle nesting
+#endif
+
+#ifndef OSC_PARSE_MAX_ELEMENTS
+#define OSC_PARSE_MAX_ELEMENTS  65536       // Bundle elements in a packet
+#endif
+
+// Deepest element path recorded in an OscParseResult
+#define OSC_PARSE_MAX_PATH  8
+
+// Where and why a packet was rejected
+typedef struct _OscParseResult {
+
+    int     error;                      // OSC_ERR_*, OSC_ERR_NONE when well formed
+    size_t  offset;                     // Byte offset of the fault in the packet
+    size_t  depth;                      // Entries in the element path
+    size_t  path [OSC_PARSE_MAX_PATH];  // Element index in each enclosing bundle,
+                                        // outermost first, only the first
+                                        // OSC_PARSE_MAX_PATH are recorded
+    int     arg;                        // Failing argument index, -1 if none
+
+} OscParseResult;
+
+// Parsed blobs point into data, which must outlive the tree. Use
+// osc_parse_result() with OSC_PARSE_COPY_BLOBS to copy them.
 OscBundle* osc_parse (const uint8_t* data, size_t size);
+OscBundle* osc_parse_ex (OscArena* arena, const uint8_t* data, size_t size);
+
+// Parses without allocating. The view borrows from the data buffer which
+// must outlive it. Returns -1 on error or when a side table overflows.
+int osc_parse_view (const uint8_t* data, size_t size, OscView* view);
+
+// Checks a packet without allocating or decoding it. Returns 0 when well
+// formed. The info (may be NULL) is filled up to the first error.
+int osc_validate (const uint8_t* data, size_t size, OscInfo* info);
+
+// Like osc_validate() with a parse mode, the first fault is described in the
+// result (may be NULL).
+int osc_validate_result (const uint8_t* data, size_t size, int mode,
+                         OscInfo* info, OscParseResult* result);
+
+// Like osc_parse_ex(), the first fault is described in the result (may be
+// NULL). In lenient mode well formed packets cost the same as osc_parse_ex(),
+// only rejected packets are walked again to locate the fault. Strict mode
+// validates before parsing.
+OscBundle* osc_parse_result (OscArena* arena, const uint8_t* data, size_t size,
+                             int mode, OscParseResult* result);
+
+// Parses into a flat OscPacket, released with a single osc_packet_delete()
+OscPacket* osc_parse_packet  (const uint8_t* data, size_t size);
+OscPacket* osc_packet_delete (const OscPacket* packet);
 
 // ============================================================================
 
 int osc_encode_message (const OscMessage* msg, uint8_t** pdata, size_t* psize);
 int osc_encode_bundle (const OscBundle* bundle, uint8_t** pdata, size_t* psize);
 
+int osc_encode_message_ex (OscArena* arena, const OscMessage* msg, uint8_t** pdata, size_t* psize);
+int osc_encode_bundle_ex (OscArena* arena, const OscBundle* bundle, uint8_t** pdata, size_t* psize);
+
+// Encoded size in bytes, 0 if the message / bundle cannot be encoded
+size_t osc_message_encoded_size (const OscMessage* msg);
+size_t osc_bundle_encoded_size  (const OscBundle* bundle);
+
+// Encode into a buffer of cap bytes. On failure -1 is returned and the
+// required size is written to *pwritten, 0 when the input is invalid.
+int osc_encode_message_into (const OscMessage* msg, uint8_t* buf, size_t cap, size_t* pwritten);
+int osc_encode_bundle_into (const OscBundle* bundle, uint8_t* buf, size_t cap, size_t* pwritten);
+
+// ============================================================================
+
+// Pre-encoded packet. Fixed width arguments and bundle timestamps can be
+// overwritten in place and the data sent again without re-encoding.
+typedef struct _OscTemplate OscTemplate;
+
+OscTemplate* osc_template_message (const OscMessage* msg);
+OscTemplate* osc_template_bundle  (const OscBundle* bundle);
+OscTemplate* osc_template_delete  (const OscTemplate* tpl);
+
+const uint8_t* osc_template_data (const OscTemplate* tpl, size_t* psize);
+
+// Argument indices count every tag of every message in wire order. Returns
+// -1 when out of range or the tag does not hold the type (i32: i, r, m, c;
+// f32: f; i64: h, t; f64: d).
+int osc_template_set_i32 (OscTemplate* tpl, size_t index, int32_t value);
+int osc_template_set_f32 (OscTemplate* tpl, size_t index, float value);
+int osc_template_set_i64 (OscTemplate* tpl, size_t index, int64_t value);
+int osc_template_set_f64 (OscTemplate* tpl, size_t index, double value);
+
+// Bundle indices are in wire order, 0 being the outermost bundle
+int osc_template_set_timestamp (OscTemplate* tpl, size_t index, int64_t timestamp);
+
+// ============================================================================
+
+// Stream (TCP) framing
+#define OSC_STREAM_LENGTH   0   // OSC 1.0 int32 size prefix
+#define OSC_STREAM_SLIP     1   // OSC 1.1 SLIP, double END
+
+// Complete packet callback
+typedef void (*OscPacketHandler) (const uint8_t* data, size_t size, void* user);
+
+// Incremental stream decoder
+typedef struct _OscStreamDecoder OscStreamDecoder;
+
+OscStreamDecoder* osc_stream_decoder_create (int mode, size_t max_size);
+OscStreamDecoder* osc_stream_decoder_delete (OscStreamDecoder* dec);
+
+void osc_stream_decoder_reset (OscStreamDecoder* dec);
+
+// Feeds a chunk of the stream. Packets complete within the chunk are passed
+// to the handler in place, only ones spanning chunks are buffered. Returns
+// the number of packets or -1 on a framing error (the decoder is reset).
+int osc_stream_decode (OscStreamDecoder* dec, const uint8_t* data, size_t size,
+                       OscPacketHandler handler, void* user);
+
+// Frames a packet. On failure -1 is returned with the required size written
+// to *pwritten.
+size_t osc_stream_encoded_size (int mode, const uint8_t* data, size_t size);
+int    osc_stream_encode (int mode, const uint8_t* data, size_t size,
+                          uint8_t* buf, size_t cap, size_t* pwritten);
+
+// ============================================================================
+
+// Bounded lock-free queue of pointers (OscBundle*, OscPacket*, ...) between
+// threads. Push and pop neither lock nor allocate. To keep freeing off a
+// realtime consumer, send items back to the producer in a second queue and
+// release them there with osc_queue_drain().
+typedef struct _OscQueue OscQueue;
+
+#define OSC_QUEUE_SPSC  0   // Single producer, single consumer
+#define OSC_QUEUE_MPSC  1   // Multiple producers, single consumer
+
+// The capacity is rounded up to a power of 2
+OscQueue* osc_queue_create (int mode, size_t capacity);
+OscQueue* osc_queue_delete (OscQueue* queue);
+
+// Ownership passes with the item. Push returns -1 when full (or the item is
+// NULL), pop returns NULL when empty. Parsed bundles keep pointing into their
+// source buffer for blobs, see OSC_PARSE_COPY_BLOBS.
+int   osc_queue_push (OscQueue* queue, void* item);
+void* osc_queue_pop  (OscQueue* queue);
+
+// Pops everything, passing each item to release. Returns the item count.
+size_t osc_queue_drain    (OscQueue* queue, void (*release) (void* item));
+size_t osc_queue_capacity (const OscQueue* queue);
+
+// ============================================================================
+
+// Parallel parser for large bundles. A framing pass splits the outer bundle
+// into its elements, a fixed set of worker threads (and the caller) parse
+// them and the results are linked in the same order as osc_parse() does.
+// Bare messages, packets below OSC_PARALLEL_MIN_SIZE and malformed framing
+// are parsed on the calling thread. Workers allocate with osc_malloc(),
+// which must then be thread safe. A parser runs one parse at a time.
+typedef struct _OscParser OscParser;
+
+#ifndef OSC_PARALLEL_MIN_SIZE
+#define OSC_PARALLEL_MIN_SIZE   8192
+#endif
+
+// Number of worker threads besides the caller
+OscParser* osc_parser_create (size_t num_threads);
+OscParser* osc_parser_delete (OscParser* parser);
+
+// Parses serially when parser is NULL
+OscBundle* osc_parse_parallel (OscParser* parser, const uint8_t* data, size_t size);
+
+// ============================================================================
+
+// Method handler
+typedef void (*OscMethod) (const OscMessage* msg, int64_t timestamp, void* user);
+
+// Address dispatcher (path segment trie)
+typedef struct _OscDispatcher OscDispatcher;
+
+OscDispatcher* osc_dispatcher_create (void);
+OscDispatcher* osc_dispatcher_delete (OscDispatcher* disp);
+
+// Registers a method at a literal address. Call osc_dispatcher_compile()
+// once done adding to enable the fast lookup.
+int  osc_dispatcher_add     (OscDispatcher* disp, const char* addr, OscMethod method, void* user);
+void osc_dispatcher_compile (OscDispatcher* disp);
+
+// Invokes methods matching the (pattern) address of the message. Returns
+// the number of invoked methods.
+size_t osc_dispatch_message (const OscDispatcher* disp, const OscMessage* msg, int64_t timestamp);
+size_t osc_dispatch_bundle  (const OscDispatcher* disp, const OscBundle* bundle);
+
+// OSC 1.0 address pattern matching
+int osc_pattern_match (const char* pattern, const char* addr);
+
+// ============================================================================
+
+// Current time as an OSC (NTP) time tag
+int64_t osc_time_now (void);
+
+// Time tag scheduler (hierarchical timing wheel, ~244 us resolution)
+typedef struct _OscScheduler OscScheduler;
+
+OscScheduler* osc_scheduler_create (OscMethod method, void* user, int64_t now);
+OscScheduler* osc_scheduler_delete (OscScheduler* sched);
+
+// Takes ownership of the bundle. Messages of each (sub-)bundle are released
+// to the method at its time tag, the bundle is deleted once all are done.
+// Blobs of parsed bundles must stay valid until then, parse bundles held
+// for later with OSC_PARSE_COPY_BLOBS.
+int osc_scheduler_add (OscScheduler* sched, OscBundle* bundle);
+
+// Releases everything due at the given time. Returns the number of messages.
+// The method may add bundles, those already due are released by the next
+// run.
+size_t osc_scheduler_run     (OscScheduler* sched, int64_t now);
+size_t osc_scheduler_pending (const OscScheduler* sched);
+
+// ============================================================================
+
+// Library counters, compiled in with OSC_STATS. Timings are in TSC ticks
+// on x86, nanoseconds elsewhere.
+typedef struct _OscStats {
+
+    uint64_t    packets_parsed;     // Successful parses (osc_parse*)
+    uint64_t    packets_encoded;    // Successful encodes (osc_encode*)
+    uint64_t    bytes_in;           // Bytes parsed
+    uint64_t    bytes_out;          // Bytes encoded
+    uint64_t    allocs;             // Heap allocations made by the library
+    uint64_t    alloc_bytes;
+    uint64_t    rejects [OSC_ERR_COUNT]; // Parse / validation failures by reason
+
+    uint64_t    parse_cycles;       // Total time in parse calls
+    uint64_t    encode_cycles;      // Total time in encode calls
+
+    uint64_t    parse_cycles_max;   // Longest single parse
+    uint64_t    encode_cycles_max;  // Longest single encode
+
+} OscStats;
+
+// Totals over all threads, or of the calling thread only. Return -1 (and
+// zeros) when built without OSC_STATS.
+int osc_stats_snapshot (OscStats* stats);
+int osc_stats_thread   (OscStats* stats);
+
 // ============================================================================
 
 #endif // OSC_H
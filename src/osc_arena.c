@@ -0,0 +1,144 @@
+#include "osc.h"
+#include "osc_stats.h"
+
+#include <string.h>
+
+// ============================================================================
+
+// Allocation alignment
+#define OSC_ARENA_ALIGN 16
+
+// Rounds up to the allocation alignment
+#define OSC_ARENA_ROUND(x) (((x) + OSC_ARENA_ALIGN - 1) & ~(size_t)(OSC_ARENA_ALIGN - 1))
+
+// Arena memory chunk, data follows the header
+typedef struct _OscArenaChunk {
+
+    struct _OscArenaChunk*  next;
+    size_t                  size;
+    size_t                  used;
+
+} OscArenaChunk;
+
+// Arena (bump allocator)
+struct _OscArena {
+
+    OscArenaChunk*  head;       // First chunk
+    OscArenaChunk*  curr;       // Chunk being allocated from
+    size_t          chunk_size; // Default chunk size
+
+};
+
+// ============================================================================
+
+static OscArenaChunk* osc_arena_chunk_create (size_t size) {
+
+    // Keep the chunk data aligned
+    size_t hsize = OSC_ARENA_ROUND(sizeof(OscArenaChunk));
+
+    OscArenaChunk* chunk = (OscArenaChunk*)osc_malloc(hsize + size);
+    if (!chunk) {
+        return NULL;
+    }
+
+    OSC_STAT_ALLOC(hsize + size);
+
+    chunk->next = NULL;
+    chunk->size = size;
+    chunk->used = 0;
+
+    return chunk;
+}
+
+static uint8_t* osc_arena_chunk_data (OscArenaChunk* chunk) {
+    return (uint8_t*)chunk + OSC_ARENA_ROUND(sizeof(OscArenaChunk));
+}
+
+// ============================================================================
+
+OscArena* osc_arena_create (size_t size) {
+
+    if (size == 0) {
+        return NULL;
+    }
+
+    OscArena* arena = (OscArena*)osc_malloc(sizeof(OscArena));
+    if (!arena) {
+        return NULL;
+    }
+
+    arena->head = osc_arena_chunk_create(size);
+    if (!arena->head) {
+        osc_free((void*)arena);
+        return NULL;
+    }
+
+    arena->curr       = arena->head;
+    arena->chunk_size = size;
+
+    return arena;
+}
+
+OscArena* osc_arena_delete (OscArena* arena) {
+
+    if (!arena) {
+        return NULL;
+    }
+
+    // Free chunks
+    for (OscArenaChunk* curr = arena->head; curr;) {
+        OscArenaChunk* next = curr->next;
+        osc_free((void*)curr);
+        curr = next;
+    }
+
+    // Free self
+    osc_free((void*)arena);
+
+    return NULL;
+}
+
+void osc_arena_reset (OscArena* arena) {
+
+    // Chunks are kept for reuse
+    for (OscArenaChunk* curr = arena->head; curr; curr = curr->next) {
+        curr->used = 0;
+    }
+
+    arena->curr = arena->head;
+}
+
+void* osc_arena_alloc (OscArena* arena, size_t size) {
+
+    // No arena, use the heap
+    if (!arena) {
+        OSC_STAT_ALLOC(size);
+        return osc_malloc(size);
+    }
+
+    // Align
+    size = OSC_ARENA_ROUND(size);
+
+    while (1) {
+        OscArenaChunk* chunk = arena->curr;
+
+        // Fits
+        if (chunk->size - chunk->used >= size) {
+            void* ptr = osc_arena_chunk_data(chunk) + chunk->used;
+            chunk->used += size;
+            return ptr;
+        }
+
+        // Grow
+        if (!chunk->next) {
+            size_t csize = (size > arena->chunk_size) ? size : arena->chunk_size;
+
+            chunk->next = osc_arena_chunk_create(csize);
+            if (!chunk->next) {
+                return NULL;
+            }
+        }
+
+        arena->curr = chunk->next;
+    }
+}
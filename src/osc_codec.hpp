@@ -0,0 +1,206 @@
+#ifndef OSC_CODEC_HPP
+#define OSC_CODEC_HPP
+
+#include "osc.h"
+
+#include <array>
+#include <cstring>
+#include <utility>
+
+// ============================================================================
+// Compile-time specialized codecs for messages with a fixed address and tag
+// string of fixed width arguments. The header bytes, argument offsets and
+// the total size are all constants:
+//
+//   static constexpr char kXY[] = "/xy";
+//   using XY = osc::Codec<kXY, 'f', 'f'>;
+//
+//   uint8_t buf[XY::size];
+//   XY::encode(buf, sizeof(buf), 0.5f, 0.25f);
+//
+//   float x, y;
+//   if (XY::decode(data, size, x, y)) { ... }
+
+namespace osc {
+
+// Placeholder value of data-less tags (T, F, N, I)
+struct Empty {};
+
+// Argument type and wire size per tag
+template <char Tag> struct TagTraits;
+
+template <> struct TagTraits<'i'> { typedef int32_t  type; static constexpr size_t width = 4; };
+template <> struct TagTraits<'f'> { typedef float    type; static constexpr size_t width = 4; };
+template <> struct TagTraits<'r'> { typedef uint32_t type; static constexpr size_t width = 4; };
+template <> struct TagTraits<'m'> { typedef uint32_t type; static constexpr size_t width = 4; };
+template <> struct TagTraits<'c'> { typedef char     type; static constexpr size_t width = 4; };
+template <> struct TagTraits<'h'> { typedef int64_t  type; static constexpr size_t width = 8; };
+template <> struct TagTraits<'d'> { typedef double   type; static constexpr size_t width = 8; };
+template <> struct TagTraits<'t'> { typedef int64_t  type; static constexpr size_t width = 8; };
+template <> struct TagTraits<'T'> { typedef Empty    type; static constexpr size_t width = 0; };
+template <> struct TagTraits<'F'> { typedef Empty    type; static constexpr size_t width = 0; };
+template <> struct TagTraits<'N'> { typedef Empty    type; static constexpr size_t width = 0; };
+template <> struct TagTraits<'I'> { typedef Empty    type; static constexpr size_t width = 0; };
+
+// ============================================================================
+
+namespace detail {
+
+constexpr size_t pad4 (size_t n) {
+    return (n + 3) & ~(size_t)3;
+}
+
+constexpr size_t length (const char* str) {
+    size_t n = 0;
+    while (str[n]) n++;
+    return n;
+}
+
+inline void store32 (uint8_t* p, uint32_t v) {
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >>  8);
+    p[3] = (uint8_t)(v);
+}
+
+inline void store64 (uint8_t* p, uint64_t v) {
+    store32(p,     (uint32_t)(v >> 32));
+    store32(p + 4, (uint32_t)(v));
+}
+
+inline uint32_t load32 (const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+           ((uint32_t)p[2] <<  8) |  (uint32_t)p[3];
+}
+
+inline uint64_t load64 (const uint8_t* p) {
+    return ((uint64_t)load32(p) << 32) | load32(p + 4);
+}
+
+template <char Tag>
+inline void put (uint8_t* p, const typename TagTraits<Tag>::type& value) {
+    typedef typename TagTraits<Tag>::type T;
+
+    if constexpr (Tag == 'c') {
+        store32(p, (uint32_t)(value & 0x7F));
+    }
+    else if constexpr (TagTraits<Tag>::width == 4) {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(T));
+        store32(p, bits);
+    }
+    else if constexpr (TagTraits<Tag>::width == 8) {
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(T));
+        store64(p, bits);
+    }
+}
+
+template <char Tag>
+inline void get (const uint8_t* p, typename TagTraits<Tag>::type& value) {
+    typedef typename TagTraits<Tag>::type T;
+
+    if constexpr (Tag == 'c') {
+        value = (char)(p[3] & 0x7F);
+    }
+    else if constexpr (TagTraits<Tag>::width == 4) {
+        uint32_t bits = load32(p);
+        std::memcpy(&value, &bits, sizeof(T));
+    }
+    else if constexpr (TagTraits<Tag>::width == 8) {
+        uint64_t bits = load64(p);
+        std::memcpy(&value, &bits, sizeof(T));
+    }
+}
+
+} // namespace detail
+
+// ============================================================================
+
+template <const char* Addr, char... Tags>
+class Codec {
+public:
+
+    static constexpr size_t addr_size   = detail::pad4(detail::length(Addr) + 1);
+    static constexpr size_t tags_size   = detail::pad4(sizeof...(Tags) + 2);
+    static constexpr size_t header_size = addr_size + tags_size;
+    static constexpr size_t args_size   = (TagTraits<Tags>::width + ... + 0);
+    static constexpr size_t size        = header_size + args_size;
+
+    // Encodes into buf, returns the size written or 0 if cap is too small
+    static size_t encode (uint8_t* buf, size_t cap,
+                          const typename TagTraits<Tags>::type&... args) {
+        if (cap < size) {
+            return 0;
+        }
+
+        std::memcpy(buf, header.data(), header_size);
+        put_args(buf + header_size, std::index_sequence_for<decltype(Tags)...>(), args...);
+
+        return size;
+    }
+
+    // Decodes a packet with exactly this address and tag string, trailing
+    // bytes are rejected like OSC_PARSE_STRICT does
+    static bool decode (const uint8_t* data, size_t len,
+                        typename TagTraits<Tags>::type&... args) {
+        if (len != size || std::memcmp(data, header.data(), header_size)) {
+            return false;
+        }
+
+        get_args(data + header_size, std::index_sequence_for<decltype(Tags)...>(), args...);
+        return true;
+    }
+
+private:
+
+    static constexpr std::array<uint8_t, header_size> make_header () {
+        std::array<uint8_t, header_size> hdr {};
+        const char tags[] = {Tags..., 0};
+
+        for (size_t i=0; Addr[i]; ++i) {
+            hdr[i] = (uint8_t)Addr[i];
+        }
+
+        hdr[addr_size] = ',';
+        for (size_t i=0; i<sizeof...(Tags); ++i) {
+            hdr[addr_size + 1 + i] = (uint8_t)tags[i];
+        }
+
+        return hdr;
+    }
+
+    static constexpr std::array<size_t, sizeof...(Tags) + 1> make_offsets () {
+        std::array<size_t, sizeof...(Tags) + 1> ofs {};
+        const size_t widths[] = {TagTraits<Tags>::width..., 0};
+
+        for (size_t i=0; i<sizeof...(Tags); ++i) {
+            ofs[i + 1] = ofs[i] + widths[i];
+        }
+
+        return ofs;
+    }
+
+    template <size_t... Is>
+    static void put_args (uint8_t* p, std::index_sequence<Is...>,
+                          const typename TagTraits<Tags>::type&... args) {
+        (detail::put<Tags>(p + offsets[Is], args), ...);
+        (void)p;
+    }
+
+    template <size_t... Is>
+    static void get_args (const uint8_t* p, std::index_sequence<Is...>,
+                          typename TagTraits<Tags>::type&... args) {
+        (detail::get<Tags>(p + offsets[Is], args), ...);
+        (void)p;
+    }
+
+    static constexpr std::array<uint8_t, header_size> header = make_header();
+    static constexpr std::array<size_t, sizeof...(Tags) + 1> offsets = make_offsets();
+};
+
+} // namespace osc
+
+// ============================================================================
+
+#endif // OSC_CODEC_HPP
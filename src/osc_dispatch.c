@@ -0,0 +1,441 @@
+#include "osc.h"
+
+#include <string.h>
+
+// ============================================================================
+
+// Registered method
+typedef struct _OscMethodEntry {
+
+    OscMethod                   method;
+    void*                       user;
+
+    struct _OscMethodEntry*     next;
+
+} OscMethodEntry;
+
+// Address trie node, one per path segment
+typedef struct _OscNode {
+
+    char*               name;       // Segment name
+    size_t              len;        // Segment name length
+
+    struct _OscNode**   children;   // Child nodes
+    size_t              count;      // Child node count
+    size_t              capacity;   // Child node array capacity
+
+    OscMethodEntry*     methods;    // Methods registered at this node
+
+} OscNode;
+
+// Dispatcher
+struct _OscDispatcher {
+
+    OscNode*    root;
+    int         compiled;   // Children are sorted
+};
+
+// ============================================================================
+
+// Matches a single pattern segment against a name segment. On a mismatch
+// only the last star takes one more character, later stars make earlier
+// ones irrelevant, which keeps the match O(n*m).
+static int osc_match_segment (const char* p, const char* pe,
+                              const char* s, const char* se) {
+
+    const char* star_p = NULL;  // Pattern after the last star
+    const char* star_s = NULL;  // Name position the star extends to
+
+    for (;;) {
+        if (p < pe) {
+            switch (*p) {
+
+                // Any single character
+                case '?':
+                    if (s < se) {
+                        p++; s++;
+                        continue;
+                    }
+                    break;
+
+                // Any sequence of characters
+                case '*':
+                    while (p < pe && *p == '*') p++;
+                    if (p == pe) return 1;
+
+                    star_p = p;
+                    star_s = s;
+                    continue;
+
+                // Character set
+                case '[': {
+                    const char* e = (const char*)memchr(p, ']', pe - p);
+                    if (!e) return 0;
+                    if (s >= se) break;
+
+                    const char* q = p + 1;
+                    int neg = (q < e && *q == '!');
+                    if (neg) q++;
+
+                    int match = 0;
+                    while (q < e) {
+                        if (q + 2 < e && q[1] == '-') {
+                            if (*s >= q[0] && *s <= q[2]) match = 1;
+                            q += 3;
+                        }
+                        else {
+                            if (*s == *q) match = 1;
+                            q += 1;
+                        }
+                    }
+
+                    if (match != neg) {
+                        p = e + 1; s++;
+                        continue;
+                    }
+                    break;
+                }
+
+                // Alternatives, the rest of the pattern is matched per
+                // alternative so the result is final for this position
+                case '{': {
+                    const char* e = (const char*)memchr(p, '}', pe - p);
+                    if (!e) return 0;
+
+                    for (const char* a = p + 1; a <= e;) {
+                        const char* ae = a;
+                        while (ae < e && *ae != ',') ae++;
+
+                        size_t len = ae - a;
+                        if ((size_t)(se - s) >= len && !memcmp(s, a, len) &&
+                            osc_match_segment(e + 1, pe, s + len, se))
+                        {
+                            return 1;
+                        }
+
+                        a = ae + 1;
+                    }
+                    break;
+                }
+
+                // Literal
+                default:
+                    if (s < se && *s == *p) {
+                        p++; s++;
+                        continue;
+                    }
+                    break;
+            }
+        }
+        else if (s == se) {
+            return 1;
+        }
+
+        // Mismatch, let the last star take one more character
+        if (!star_p || star_s >= se) {
+            return 0;
+        }
+
+        p = star_p;
+        s = ++star_s;
+    }
+}
+
+// Returns non-zero if the segment contains pattern characters
+static int osc_is_pattern (const char* s, const char* se) {
+    for (; s < se; ++s) {
+        if (*s == '?' || *s == '*' || *s == '[' || *s == '{') {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static const char* osc_segment_end (const char* s) {
+    while (*s && *s != '/') s++;
+    return s;
+}
+
+int osc_pattern_match (const char* pattern, const char* addr) {
+
+    if (*pattern != '/' || *addr != '/') {
+        return 0;
+    }
+
+    // Match segment by segment, wildcards do not span '/'
+    while (*pattern && *addr) {
+        const char* p = pattern + 1;
+        const char* s = addr + 1;
+
+        const char* pe = osc_segment_end(p);
+        const char* se = osc_segment_end(s);
+
+        if (!osc_match_segment(p, pe, s, se)) {
+            return 0;
+        }
+
+        pattern = pe;
+        addr    = se;
+    }
+
+    return (*pattern == 0 && *addr == 0);
+}
+
+// ============================================================================
+
+static OscNode* osc_node_create (const char* name, size_t len) {
+
+    OscNode* node = (OscNode*)osc_malloc(sizeof(OscNode));
+
+    node->name = (char*)osc_malloc(len + 1);
+    memcpy(node->name, name, len);
+    node->name[len] = 0;
+
+    node->len      = len;
+    node->children = NULL;
+    node->count    = 0;
+    node->capacity = 0;
+    node->methods  = NULL;
+
+    return node;
+}
+
+static void osc_node_delete (OscNode* node) {
+
+    for (size_t i=0; i<node->count; ++i) {
+        osc_node_delete(node->children[i]);
+    }
+
+    for (OscMethodEntry* curr = node->methods; curr;) {
+        OscMethodEntry* next = curr->next;
+        osc_free((void*)curr);
+        curr = next;
+    }
+
+    if (node->children) {
+        osc_free((void*)node->children);
+    }
+
+    osc_free((void*)node->name);
+    osc_free((void*)node);
+}
+
+static int osc_node_compare (const char* a, size_t alen,
+                             const char* b, size_t blen) {
+
+    int res = memcmp(a, b, (alen < blen) ? alen : blen);
+    if (res) return res;
+
+    return (alen < blen) ? -1 : (alen > blen);
+}
+
+static int osc_node_sort (const void* a, const void* b) {
+    const OscNode* na = *(const OscNode* const*)a;
+    const OscNode* nb = *(const OscNode* const*)b;
+    return osc_node_compare(na->name, na->len, nb->name, nb->len);
+}
+
+static void osc_node_compile (OscNode* node) {
+
+    qsort((void*)node->children, node->count, sizeof(OscNode*), osc_node_sort);
+
+    for (size_t i=0; i<node->count; ++i) {
+        osc_node_compile(node->children[i]);
+    }
+}
+
+static OscNode* osc_node_find (const OscNode* node, const char* name,
+                               size_t len, int compiled) {
+
+    // Binary search
+    if (compiled) {
+        size_t lo = 0;
+        size_t hi = node->count;
+
+        while (lo < hi) {
+            size_t   mid   = (lo + hi) / 2;
+            OscNode* child = node->children[mid];
+
+            int res = osc_node_compare(name, len, child->name, child->len);
+            if (res == 0) return child;
+
+            if (res < 0) hi = mid;
+            else         lo = mid + 1;
+        }
+
+        return NULL;
+    }
+
+    // Linear search
+    for (size_t i=0; i<node->count; ++i) {
+        OscNode* child = node->children[i];
+        if (!osc_node_compare(name, len, child->name, child->len)) {
+            return child;
+        }
+    }
+
+    return NULL;
+}
+
+static OscNode* osc_node_add (OscNode* node, const char* name, size_t len) {
+
+    // Grow the child array
+    if (node->count == node->capacity) {
+        size_t    capacity = node->capacity ? node->capacity * 2 : 4;
+        OscNode** children = (OscNode**)osc_malloc(capacity * sizeof(OscNode*));
+
+        if (node->children) {
+            memcpy((void*)children, (void*)node->children, node->count * sizeof(OscNode*));
+            osc_free((void*)node->children);
+        }
+
+        node->children = children;
+        node->capacity = capacity;
+    }
+
+    OscNode* child = osc_node_create(name, len);
+    node->children[node->count++] = child;
+
+    return child;
+}
+
+// ============================================================================
+
+OscDispatcher* osc_dispatcher_create (void) {
+
+    OscDispatcher* disp = (OscDispatcher*)osc_malloc(sizeof(OscDispatcher));
+    disp->root     = osc_node_create("", 0);
+    disp->compiled = 1;
+
+    return disp;
+}
+
+OscDispatcher* osc_dispatcher_delete (OscDispatcher* disp) {
+
+    if (!disp) {
+        return NULL;
+    }
+
+    osc_node_delete(disp->root);
+    osc_free((void*)disp);
+
+    return NULL;
+}
+
+int osc_dispatcher_add (OscDispatcher* disp, const char* addr,
+                        OscMethod method, void* user) {
+
+    if (!addr || *addr != '/' || !method) {
+        return -1;
+    }
+
+    // Method addresses cannot contain pattern characters
+    if (strpbrk(addr, " #*,?[]{}")) {
+        return -1;
+    }
+
+    // Walk / extend the trie
+    OscNode* node = disp->root;
+    while (*addr) {
+        const char* s  = addr + 1;
+        const char* se = osc_segment_end(s);
+
+        if (se == s) {
+            return -1;
+        }
+
+        OscNode* child = osc_node_find(node, s, se - s, 0);
+        if (!child) {
+            child = osc_node_add(node, s, se - s);
+            disp->compiled = 0;
+        }
+
+        node = child;
+        addr = se;
+    }
+
+    // Append the method, keeps registration order
+    OscMethodEntry* entry = (OscMethodEntry*)osc_malloc(sizeof(OscMethodEntry));
+    entry->method = method;
+    entry->user   = user;
+    entry->next   = NULL;
+
+    OscMethodEntry** tail = &node->methods;
+    while (*tail) tail = &(*tail)->next;
+    *tail = entry;
+
+    return 0;
+}
+
+void osc_dispatcher_compile (OscDispatcher* disp) {
+    osc_node_compile(disp->root);
+    disp->compiled = 1;
+}
+
+// ============================================================================
+
+static size_t osc_dispatch_node (const OscDispatcher* disp, const OscNode* node,
+                                 const char* pattern, const OscMessage* msg,
+                                 int64_t timestamp) {
+
+    // End of the address, invoke methods
+    if (*pattern == 0) {
+        size_t count = 0;
+        for (const OscMethodEntry* e = node->methods; e; e = e->next) {
+            e->method(msg, timestamp, e->user);
+            count++;
+        }
+        return count;
+    }
+
+    const char* p  = pattern + 1;
+    const char* pe = osc_segment_end(p);
+
+    // Literal segment, direct lookup
+    if (!osc_is_pattern(p, pe)) {
+        const OscNode* child = osc_node_find(node, p, pe - p, disp->compiled);
+        if (!child) {
+            return 0;
+        }
+
+        return osc_dispatch_node(disp, child, pe, msg, timestamp);
+    }
+
+    // Pattern segment, match all children
+    size_t count = 0;
+    for (size_t i=0; i<node->count; ++i) {
+        const OscNode* child = node->children[i];
+        if (osc_match_segment(p, pe, child->name, child->name + child->len)) {
+            count += osc_dispatch_node(disp, child, pe, msg, timestamp);
+        }
+    }
+
+    return count;
+}
+
+size_t osc_dispatch_message (const OscDispatcher* disp, const OscMessage* msg,
+                             int64_t timestamp) {
+
+    if (!msg->addr || *msg->addr != '/') {
+        return 0;
+    }
+
+    return osc_dispatch_node(disp, disp->root, msg->addr, msg, timestamp);
+}
+
+size_t osc_dispatch_bundle (const OscDispatcher* disp, const OscBundle* bundle) {
+
+    size_t count = 0;
+
+    // Messages
+    for (const OscMessage* msg = bundle->messages; msg; msg = msg->next) {
+        count += osc_dispatch_message(disp, msg, bundle->timestamp);
+    }
+
+    // Sub-bundles
+    for (const OscBundle* bun = bundle->bundles; bun; bun = bun->next) {
+        count += osc_dispatch_bundle(disp, bun);
+    }
+
+    return count;
+}
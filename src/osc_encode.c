@@ -1,10 +1,25 @@
 #include "osc.h"
+#include "osc_plan.h"
+#include "osc_stats.h"
 
 #include <string.h>
 
 // ============================================================================
 
-static size_t osc_message_size (const OscMessage* msg) {
+// Returned by the writers when the buffer is too small, 0 means invalid input
+#define OSC_WRITE_FULL  SIZE_MAX
+
+// Stack scratch of the allocating encoders, larger packets go to the heap
+#ifndef OSC_ENCODE_SCRATCH
+#define OSC_ENCODE_SCRATCH  4096
+#endif
+
+// Size of the last packet that did not fit the scratch, first heap guess
+static __thread size_t osc_encode_hint = 0;
+
+// ============================================================================
+
+size_t osc_message_encoded_size (const OscMessage* msg) {
 
     size_t size = 0;
 
@@ -13,11 +28,19 @@ static size_t osc_message_size (const OscMessage* msg) {
     if (size & 3) size = (size & ~3) + 4;
 
     // Tag string + padding
-    size += strlen(msg->tags) + 2;
+    size += msg->num_args + 2;
     if (size & 3) size = (size & ~3) + 4;
 
+    // Fixed layout
+    const OscPlan* plan = osc_plan_get(msg->tags, msg->num_args);
+    if (plan) {
+        if (!plan->valid) return 0;
+        if (plan->fixed)  return size + plan->size;
+    }
+
     // Arguments
-    for (size_t i=0; i<strlen(msg->tags); ++i) {
+    int depth = 0;
+    for (size_t i=0; i<msg->num_args; ++i) {
 
         // Argument size
         size_t arg_size = 0;
@@ -49,12 +72,26 @@ static size_t osc_message_size (const OscMessage* msg) {
             case 'I':
                 break;
 
+            case '[':
+                depth++;
+                break;
+
+            case ']':
+                if (--depth < 0) return 0;
+                break;
+
             case 's':
             case 'S':
                 arg_size = strlen(msg->args[i].str) + 1;
                 if (arg_size & 3) arg_size = (arg_size & ~3) + 4;
                 break;
 
+            case 'b':
+                if (msg->args[i].blob.size < 0) return 0;
+                arg_size = 4 + (size_t)msg->args[i].blob.size;
+                if (arg_size & 3) arg_size = (arg_size & ~3) + 4;
+                break;
+
             // Unknown, error
             default:
                 return 0;
@@ -63,10 +100,10 @@ static size_t osc_message_size (const OscMessage* msg) {
         size += arg_size;
     }
 
-    return size;
+    return depth ? 0 : size;
 }
 
-static size_t osc_bundle_size (const OscBundle* bundle) {
+size_t osc_bundle_encoded_size (const OscBundle* bundle) {
 
     size_t size = 0;
 
@@ -75,7 +112,7 @@ static size_t osc_bundle_size (const OscBundle* bundle) {
 
     // Messages
     for (const OscMessage* msg = bundle->messages; msg; msg = msg->next) {
-        size_t len = osc_message_size(msg);
+        size_t len = osc_message_encoded_size(msg);
         if (!len) return 0;
 
         size += 4 + len;
@@ -83,7 +120,7 @@ static size_t osc_bundle_size (const OscBundle* bundle) {
 
     // Bundles
     for (const OscBundle* bun = bundle->bundles; bun; bun = bun->next) {
-        size_t len = osc_bundle_size(bun);
+        size_t len = osc_bundle_encoded_size(bun);
         if (!len) return 0;
 
         size += 4 + len;
@@ -92,39 +129,103 @@ static size_t osc_bundle_size (const OscBundle* bundle) {
     return size;
 }
 
-// ============================================================================
+// Writes a string with its terminator and padding. Returns the new pointer
+// or OSC_WRITE_FULL if it does not fit.
+static size_t osc_write_string (uint8_t* data, size_t cap, size_t ptr,
+                                const char* str, size_t len) {
 
-int osc_encode_message (const OscMessage* msg, uint8_t** pdata, size_t* psize)
-{
-    // Allocate buffer if needed
-    uint8_t* data = *pdata;
-    if (data == NULL) {
+    if (((ptr + len + 4) & ~(size_t)3) > cap) {
+        return OSC_WRITE_FULL;
+    }
+
+    memcpy(&data[ptr], str, len);
+    ptr += len;
+
+    // Terminator + padding
+    data[ptr++] = 0;
+    for (; ptr & 3; ++ptr) data[ptr] = 0;
+
+    return ptr;
+}
 
-        // Compute message size
-        size_t size = osc_message_size(msg);
-        if (size == 0) return -1;
+// Writes a blob with its size and padding. Returns the new pointer, 0 for a
+// negative size or OSC_WRITE_FULL if it does not fit.
+static size_t osc_write_blob (uint8_t* data, size_t cap, size_t ptr,
+                              const uint8_t* blob, int32_t size) {
 
-        // Allocate the buffer
-        data = (uint8_t*)osc_malloc(size);
-        if (!data) return -1;
+    if (size < 0) {
+        return 0;
     }
 
+    size_t len = (size_t)size;
+    if (((ptr + 4 + len + 3) & ~(size_t)3) > cap) {
+        return OSC_WRITE_FULL;
+    }
+
+    // Size
+    for (size_t i=0; i<4; ++i) {
+        data[ptr++] = ((len << (8 * i)) >> 24) & 0xFF;
+    }
+
+    // Data + padding
+    memcpy(&data[ptr], blob, len);
+    ptr += len;
+    for (; ptr & 3; ++ptr) data[ptr] = 0;
+
+    return ptr;
+}
+
+// Encodes a message into a buffer of cap bytes. Returns the size written,
+// 0 on error or OSC_WRITE_FULL when the buffer is too small.
+static size_t osc_write_message (const OscMessage* msg, uint8_t* data, size_t cap) {
+
     size_t ptr = 0;
-    size_t len;
 
     // Encode address string
-    strcpy((char*)&data[ptr], msg->addr);
-    ptr += strlen(msg->addr) + 1;
-    for (; ptr & 3; ++ptr) data[ptr] = 0;
+    ptr = osc_write_string(data, cap, ptr, msg->addr, strlen(msg->addr));
+    if (ptr == OSC_WRITE_FULL || ptr == cap) return OSC_WRITE_FULL;
 
     // Encode tags string
     data[ptr++] = ',';
-    strcpy((char*)&data[ptr], msg->tags);
-    ptr += strlen(msg->tags) + 1;
-    for (; ptr & 3; ++ptr) data[ptr] = 0;
+    ptr = osc_write_string(data, cap, ptr, msg->tags, msg->num_args);
+    if (ptr == OSC_WRITE_FULL) return ptr;
+
+    const OscPlan* plan = osc_plan_get(msg->tags, msg->num_args);
+    if (plan && !plan->valid) {
+        return 0;
+    }
+
+    // Fixed layout, a single bounds check
+    if (plan && plan->fixed) {
+        if (plan->size > cap - ptr) return OSC_WRITE_FULL;
+
+        uint8_t* base = &data[ptr];
+        for (size_t i=0; i<msg->num_args; ++i) {
+            const OscPlanStep* step = &plan->steps[i];
+            uint8_t*           dst  = &base[step->offset];
+
+            switch (step->kind) {
+                case OSC_KIND_32:
+                    for (size_t j=0; j<4; ++j) dst[j] = msg->args[i].b[3 - j];
+                    break;
+                case OSC_KIND_64:
+                    for (size_t j=0; j<8; ++j) dst[j] = msg->args[i].b[7 - j];
+                    break;
+                case OSC_KIND_CHAR:
+                    dst[0] = 0;
+                    dst[1] = 0;
+                    dst[2] = 0;
+                    dst[3] = msg->args[i].i32 & 0x7F;
+                    break;
+            }
+        }
+
+        return ptr + plan->size;
+    }
 
     // Encode arguments
-    for (size_t i=0; i<strlen(msg->tags); ++i) {
+    int depth = 0;
+    for (size_t i=0; i<msg->num_args; ++i) {
         switch (msg->tags[i]) {
 
             // 32-bit
@@ -132,6 +233,7 @@ int osc_encode_message (const OscMessage* msg, uint8_t** pdata, size_t* psize)
             case 'f':
             case 'r':
             case 'm':
+                if (ptr + 4 > cap) return OSC_WRITE_FULL;
                 for (size_t j=0; j<4; ++j) {
                     data[ptr++] = msg->args[i].b[3 - j];
                 }
@@ -141,6 +243,7 @@ int osc_encode_message (const OscMessage* msg, uint8_t** pdata, size_t* psize)
             case 'h':
             case 'd':
             case 't':
+                if (ptr + 8 > cap) return OSC_WRITE_FULL;
                 for (size_t j=0; j<8; ++j) {
                     data[ptr++] = msg->args[i].b[7 - j];
                 }
@@ -148,6 +251,7 @@ int osc_encode_message (const OscMessage* msg, uint8_t** pdata, size_t* psize)
 
             // char as 32-bit
             case 'c':
+                if (ptr + 4 > cap) return OSC_WRITE_FULL;
                 data[ptr++] = 0;
                 data[ptr++] = 0;
                 data[ptr++] = 0;
@@ -161,68 +265,67 @@ int osc_encode_message (const OscMessage* msg, uint8_t** pdata, size_t* psize)
             case 'I':
                 break;
 
+            // Arrays
+            case '[':
+                depth++;
+                break;
+
+            case ']':
+                if (--depth < 0) return 0;
+                break;
+
             // String
             case 's':
             case 'S':
-                len = strlen(msg->args[i].str);
-                memcpy(&data[ptr], msg->args[i].str, len);
-                ptr += len; data[ptr++] = 0;
-                for (; ptr & 3; ++ptr) data[ptr] = 0;
+                ptr = osc_write_string(data, cap, ptr, msg->args[i].str,
+                                       strlen(msg->args[i].str));
+                if (ptr == OSC_WRITE_FULL) return ptr;
+                break;
+
+            // Blob
+            case 'b':
+                ptr = osc_write_blob(data, cap, ptr, msg->args[i].blob.data,
+                                     msg->args[i].blob.size);
+                if (!ptr || ptr == OSC_WRITE_FULL) return ptr;
                 break;
 
             // Unknown, error
             default:
-                // FIXME: Free buffer if allocated !
-                return -1;
+                return 0;
         }
     }
 
-    // Finish
-    *pdata = data;
-    if (psize) {
-        *psize = ptr;
-    }
-
-    return 0;
+    return depth ? 0 : ptr;
 }
 
-int osc_encode_bundle (const OscBundle* bundle, uint8_t** pdata, size_t* psize)
-{
-    // Allocate buffer if needed
-    uint8_t* data = *pdata;
-    if (data == NULL) {
+// Encodes a bundle into a buffer of cap bytes. Element sizes are written
+// back once each element is encoded. Returns the size written, 0 on error or
+// OSC_WRITE_FULL when the buffer is too small.
+static size_t osc_write_bundle (const OscBundle* bundle, uint8_t* data, size_t cap) {
 
-        // Compute bundle size
-        size_t size = osc_bundle_size(bundle);
-        if (size == 0) return -1;
+    size_t ptr = 0;
 
-        // Allocate the buffer
-        data = (uint8_t*)osc_malloc(size);
-        if (!data) return -1;
+    if (cap < 16) {
+        return OSC_WRITE_FULL;
     }
 
-    size_t ptr = 0;
-
     // Magic word
     const uint8_t magic[] = {'#', 'b', 'u', 'n', 'd', 'l', 'e', 0};
     memcpy(&data[ptr], magic, sizeof(magic)); ptr += sizeof(magic);
 
     // Timestamp
     for (size_t i=0; i<8; ++i) {
-        data[ptr++] = ((bundle->timestamp << (8 * i)) >> 56) & 0xFF;
+        data[ptr++] = (((uint64_t)bundle->timestamp << (8 * i)) >> 56) & 0xFF;
     }
 
     // Messages
     for (const OscMessage* msg = bundle->messages; msg; msg = msg->next) {
 
-        // Content
-        uint8_t* buf = &data[ptr + 4];
-        size_t   len = 0;
+        if (cap - ptr < 4) return OSC_WRITE_FULL;
 
-        if (osc_encode_message(msg, &buf, &len)) {
-            // FIXME: Free buffer if allocated !
-            return -1;
-        }
+        // Content
+        size_t len = osc_write_message(msg, &data[ptr + 4], cap - ptr - 4);
+        if (!len || len == OSC_WRITE_FULL) return len;
 
         // Size
         for (size_t i=0; i<4; ++i) {
@@ -235,14 +338,11 @@ int osc_encode_bundle (const OscBundle* bundle, uint8_t** pdata, size_t* psize)
     // Bundles
     for (const OscBundle* bun = bundle->bundles; bun; bun = bun->next) {
 
-        // Content
-        uint8_t* buf = &data[ptr + 4];
-        size_t   len = 0;
+        if (cap - ptr < 4) return OSC_WRITE_FULL;
 
-        if (osc_encode_bundle(bun, &buf, &len)) {
-            // FIXME: Free buffer if allocated !
-            return -1;
-        }
+        // Content
+        size_t len = osc_write_bundle(bun, &data[ptr + 4], cap - ptr - 4);
+        if (!len || len == OSC_WRITE_FULL) return len;
 
         // Size
         for (size_t i=0; i<4; ++i) {
@@ -252,10 +352,149 @@ int osc_encode_bundle (const OscBundle* bundle, uint8_t** pdata, size_t* psize)
         ptr += len;
     }
 
-    // Finish
-    *pdata = data;
+    return ptr;
+}
+
+// ============================================================================
+
+// Encodes a message or a bundle in a single pass into the stack scratch, or
+// a heap buffer doubled until the packet fits, then copies it once into an
+// exact allocation. Returns the size, 0 on error.
+static size_t osc_encode_alloc (OscArena* arena, const OscMessage* msg,
+                                const OscBundle* bundle, uint8_t** pdata) {
+
+    uint8_t  scratch [OSC_ENCODE_SCRATCH];
+    uint8_t* buf  = scratch;
+    size_t   cap  = sizeof(scratch);
+    size_t   size = 0;
+
+    for (;;) {
+        size = msg ? osc_write_message(msg, buf, cap) : osc_write_bundle(bundle, buf, cap);
+        if (size != OSC_WRITE_FULL) {
+            break;
+        }
+
+        if (buf != scratch) osc_free((void*)buf);
+
+        cap = cap * 2 > osc_encode_hint ? cap * 2 : osc_encode_hint;
+        buf = (uint8_t*)osc_malloc(cap);
+        if (!buf) {
+            return 0;
+        }
+
+        OSC_STAT_ALLOC(cap);
+    }
+
+    if (buf != scratch && size) {
+        osc_encode_hint = size + size / 4;
+    }
+
+    uint8_t* data = size ? (uint8_t*)osc_arena_alloc(arena, size) : NULL;
+    if (data) {
+        memcpy(data, buf, size);
+        *pdata = data;
+    }
+
+    if (buf != scratch) osc_free((void*)buf);
+
+    return data ? size : 0;
+}
+
+int osc_encode_message (const OscMessage* msg, uint8_t** pdata, size_t* psize)
+{
+    return osc_encode_message_ex(NULL, msg, pdata, psize);
+}
+
+int osc_encode_message_ex (OscArena* arena, const OscMessage* msg,
+                           uint8_t** pdata, size_t* psize)
+{
+    OSC_STAT_START(start);
+
+    // Allocate the buffer if needed. A given buffer is assumed large enough.
+    size_t size = *pdata ? osc_write_message(msg, *pdata, SIZE_MAX) :
+                           osc_encode_alloc(arena, msg, NULL, pdata);
+
+    OSC_STAT_ENCODED(start, size, size != 0);
+
+    if (!size) {
+        return -1;
+    }
+
     if (psize) {
-        *psize = ptr;
+        *psize = size;
+    }
+
+    return 0;
+}
+
+int osc_encode_bundle (const OscBundle* bundle, uint8_t** pdata, size_t* psize)
+{
+    return osc_encode_bundle_ex(NULL, bundle, pdata, psize);
+}
+
+int osc_encode_bundle_ex (OscArena* arena, const OscBundle* bundle,
+                          uint8_t** pdata, size_t* psize)
+{
+    OSC_STAT_START(start);
+
+    // Allocate the buffer if needed. A given buffer is assumed large enough.
+    size_t size = *pdata ? osc_write_bundle(bundle, *pdata, SIZE_MAX) :
+                           osc_encode_alloc(arena, NULL, bundle, pdata);
+
+    OSC_STAT_ENCODED(start, size, size != 0);
+
+    if (!size) {
+        return -1;
+    }
+
+    if (psize) {
+        *psize = size;
+    }
+
+    return 0;
+}
+
+// ============================================================================
+
+int osc_encode_message_into (const OscMessage* msg, uint8_t* buf, size_t cap,
+                             size_t* pwritten)
+{
+    OSC_STAT_START(start);
+    size_t size = osc_write_message(msg, buf, cap);
+    OSC_STAT_ENCODED(start, size, size != 0 && size != OSC_WRITE_FULL);
+
+    // Report the required size, zero for invalid messages
+    if (!size || size == OSC_WRITE_FULL) {
+        if (pwritten) {
+            *pwritten = size ? osc_message_encoded_size(msg) : 0;
+        }
+        return -1;
+    }
+
+    if (pwritten) {
+        *pwritten = size;
+    }
+
+    return 0;
+}
+
+int osc_encode_bundle_into (const OscBundle* bundle, uint8_t* buf, size_t cap,
+                            size_t* pwritten)
+{
+    OSC_STAT_START(start);
+    size_t size = osc_write_bundle(bundle, buf, cap);
+    OSC_STAT_ENCODED(start, size, size != 0 && size != OSC_WRITE_FULL);
+
+    // Report the required size, zero for invalid bundles
+    if (!size || size == OSC_WRITE_FULL) {
+        if (pwritten) {
+            *pwritten = size ? osc_bundle_encoded_size(bundle) : 0;
+        }
+        return -1;
+    }
+
+    if (pwritten) {
+        *pwritten = size;
     }
 
     return 0;
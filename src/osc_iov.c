@@ -0,0 +1,309 @@
+#include "osc_net.h"
+#include "osc_stats.h"
+
+#include <string.h>
+
+// ============================================================================
+
+// Scatter-gather writer state
+typedef struct _OscIovWriter {
+
+    struct iovec*   iov;
+    size_t          max_iov;
+    size_t          num_iov;
+
+    uint8_t*        scratch;
+    size_t          cap;
+    size_t          used;
+
+    size_t          size;   // Total encoded size
+
+} OscIovWriter;
+
+// ============================================================================
+
+// Reserves bytes in the scratch buffer, extends the last segment when it is
+// contiguous with them
+static uint8_t* osc_iov_bytes (OscIovWriter* w, size_t len) {
+
+    if (w->cap - w->used < len) {
+        return NULL;
+    }
+
+    uint8_t* ptr  = &w->scratch[w->used];
+    struct iovec* last = w->num_iov ? &w->iov[w->num_iov - 1] : NULL;
+
+    if (last && (uint8_t*)last->iov_base + last->iov_len == ptr) {
+        last->iov_len += len;
+    }
+    else {
+        if (w->num_iov == w->max_iov) {
+            return NULL;
+        }
+
+        w->iov[w->num_iov].iov_base = ptr;
+        w->iov[w->num_iov].iov_len  = len;
+        w->num_iov++;
+    }
+
+    w->used += len;
+    w->size += len;
+
+    return ptr;
+}
+
+// References caller memory
+static int osc_iov_ref (OscIovWriter* w, const void* data, size_t len) {
+
+    if (w->num_iov == w->max_iov) {
+        return -1;
+    }
+
+    w->iov[w->num_iov].iov_base = (void*)data;
+    w->iov[w->num_iov].iov_len  = len;
+    w->num_iov++;
+
+    w->size += len;
+    return 0;
+}
+
+// String with terminator and padding, long ones are referenced
+static int osc_iov_string (OscIovWriter* w, const char* str, size_t len) {
+
+    size_t pad = 4 - (w->size + len) % 4;
+
+    if (len >= OSC_IOV_MIN_REF) {
+        if (osc_iov_ref(w, str, len)) return -1;
+    }
+    else {
+        uint8_t* ptr = osc_iov_bytes(w, len);
+        if (!ptr) return -1;
+        memcpy(ptr, str, len);
+    }
+
+    uint8_t* ptr = osc_iov_bytes(w, pad);
+    if (!ptr) return -1;
+    memset(ptr, 0, pad);
+
+    return 0;
+}
+
+// Blob with its size and padding, long ones are referenced
+static int osc_iov_blob (OscIovWriter* w, const uint8_t* data, int32_t size) {
+
+    if (size < 0) {
+        return -1;
+    }
+
+    size_t len = (size_t)size;
+
+    uint8_t* ptr = osc_iov_bytes(w, 4);
+    if (!ptr) return -1;
+    for (size_t i=0; i<4; ++i) {
+        ptr[i] = ((len << (8 * i)) >> 24) & 0xFF;
+    }
+
+    if (len >= OSC_IOV_MIN_REF) {
+        if (osc_iov_ref(w, data, len)) return -1;
+    }
+    else if (len) {
+        ptr = osc_iov_bytes(w, len);
+        if (!ptr) return -1;
+        memcpy(ptr, data, len);
+    }
+
+    size_t pad = (4 - len % 4) % 4;
+    if (pad) {
+        ptr = osc_iov_bytes(w, pad);
+        if (!ptr) return -1;
+        memset(ptr, 0, pad);
+    }
+
+    return 0;
+}
+
+static int osc_iov_message (OscIovWriter* w, const OscMessage* msg) {
+
+    // Address
+    if (osc_iov_string(w, msg->addr, strlen(msg->addr))) {
+        return -1;
+    }
+
+    // Tags
+    uint8_t* ptr = osc_iov_bytes(w, 1);
+    if (!ptr) return -1;
+    *ptr = ',';
+
+    if (osc_iov_string(w, msg->tags, msg->num_args)) {
+        return -1;
+    }
+
+    // Arguments
+    int depth = 0;
+    for (size_t i=0; i<msg->num_args; ++i) {
+        switch (msg->tags[i]) {
+
+            // 32-bit
+            case 'i':
+            case 'f':
+            case 'r':
+            case 'm':
+                ptr = osc_iov_bytes(w, 4);
+                if (!ptr) return -1;
+                for (size_t j=0; j<4; ++j) {
+                    ptr[j] = msg->args[i].b[3 - j];
+                }
+                break;
+
+            // 64-bit
+            case 'h':
+            case 'd':
+            case 't':
+                ptr = osc_iov_bytes(w, 8);
+                if (!ptr) return -1;
+                for (size_t j=0; j<8; ++j) {
+                    ptr[j] = msg->args[i].b[7 - j];
+                }
+                break;
+
+            // char as 32-bit
+            case 'c':
+                ptr = osc_iov_bytes(w, 4);
+                if (!ptr) return -1;
+                ptr[0] = 0;
+                ptr[1] = 0;
+                ptr[2] = 0;
+                ptr[3] = msg->args[i].i32 & 0x7F;
+                break;
+
+            // Data-less
+            case 'T':
+            case 'F':
+            case 'N':
+            case 'I':
+                break;
+
+            // Arrays
+            case '[':
+                depth++;
+                break;
+
+            case ']':
+                if (--depth < 0) return -1;
+                break;
+
+            // String
+            case 's':
+            case 'S':
+                if (osc_iov_string(w, msg->args[i].str, strlen(msg->args[i].str))) {
+                    return -1;
+                }
+                break;
+
+            // Blob
+            case 'b':
+                if (osc_iov_blob(w, msg->args[i].blob.data, msg->args[i].blob.size)) {
+                    return -1;
+                }
+                break;
+
+            // Unknown, error
+            default:
+                return -1;
+        }
+    }
+
+    return depth ? -1 : 0;
+}
+
+static int osc_iov_bundle (OscIovWriter* w, const OscBundle* bundle) {
+
+    uint8_t* ptr = osc_iov_bytes(w, 16);
+    if (!ptr) return -1;
+
+    // Magic word
+    const uint8_t magic[] = {'#', 'b', 'u', 'n', 'd', 'l', 'e', 0};
+    memcpy(ptr, magic, sizeof(magic));
+
+    // Timestamp
+    for (size_t i=0; i<8; ++i) {
+        ptr[8 + i] = (((uint64_t)bundle->timestamp << (8 * i)) >> 56) & 0xFF;
+    }
+
+    // Elements, sizes are written back once known
+    for (const OscMessage* msg = bundle->messages; msg; msg = msg->next) {
+
+        uint8_t* len = osc_iov_bytes(w, 4);
+        if (!len) return -1;
+
+        size_t start = w->size;
+        if (osc_iov_message(w, msg)) return -1;
+
+        size_t size = w->size - start;
+        for (size_t i=0; i<4; ++i) {
+            len[i] = ((size << (8 * i)) >> 24) & 0xFF;
+        }
+    }
+
+    for (const OscBundle* bun = bundle->bundles; bun; bun = bun->next) {
+
+        uint8_t* len = osc_iov_bytes(w, 4);
+        if (!len) return -1;
+
+        size_t start = w->size;
+        if (osc_iov_bundle(w, bun)) return -1;
+
+        size_t size = w->size - start;
+        for (size_t i=0; i<4; ++i) {
+            len[i] = ((size << (8 * i)) >> 24) & 0xFF;
+        }
+    }
+
+    return 0;
+}
+
+// ============================================================================
+
+int osc_encode_message_iov (const OscMessage* msg,
+                            struct iovec* iov, size_t max_iov, size_t* pnum_iov,
+                            uint8_t* scratch, size_t cap, size_t* psize) {
+
+    OscIovWriter w = {iov, max_iov, 0, scratch, cap, 0, 0};
+
+    OSC_STAT_START(start);
+    int res = osc_iov_message(&w, msg);
+    OSC_STAT_ENCODED(start, w.size, res == 0);
+
+    if (res) {
+        return -1;
+    }
+
+    *pnum_iov = w.num_iov;
+    if (psize) {
+        *psize = w.size;
+    }
+
+    return 0;
+}
+
+int osc_encode_bundle_iov (const OscBundle* bundle,
+                           struct iovec* iov, size_t max_iov, size_t* pnum_iov,
+                           uint8_t* scratch, size_t cap, size_t* psize) {
+
+    OscIovWriter w = {iov, max_iov, 0, scratch, cap, 0, 0};
+
+    OSC_STAT_START(start);
+    int res = osc_iov_bundle(&w, bundle);
+    OSC_STAT_ENCODED(start, w.size, res == 0);
+
+    if (res) {
+        return -1;
+    }
+
+    *pnum_iov = w.num_iov;
+    if (psize) {
+        *psize = w.size;
+    }
+
+    return 0;
+}
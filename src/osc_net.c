@@ -0,0 +1,422 @@
+#include "osc_net.h"
+
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include <sys/uio.h>
+
+// ============================================================================
+
+// Batched datagram receiver
+struct _OscNetRx {
+
+    int                         fd;
+    size_t                      batch;  // Max datagrams per syscall
+    size_t                      mtu;    // Max datagram size
+    size_t                      count;  // Datagrams in the last batch
+    int                         mode;   // Parse mode
+
+    uint8_t*                    slab;   // Datagram buffers (batch * mtu)
+    struct mmsghdr*             msgs;
+    struct iovec*               iovs;
+    struct sockaddr_storage*    addrs;
+};
+
+// Batched datagram sender
+struct _OscNetTx {
+
+    int                         fd;
+    size_t                      slots;  // Packet buffer count
+    size_t                      mtu;    // Packet buffer size
+    size_t                      depth;  // Max queued datagrams
+
+    size_t                      used;   // Slots in use
+    size_t                      queued; // Datagrams queued
+    size_t                      dropped; // Datagrams that failed to send
+
+    size_t                      flush_count;
+    uint64_t                    flush_ns;
+    uint64_t                    deadline;
+
+    uint8_t*                    slab;   // Packet buffers (slots * mtu)
+    struct mmsghdr*             msgs;
+    struct iovec*               iovs;
+    OscNetAddr*                 addrs;  // Destination copies
+};
+
+// ============================================================================
+
+OscNetRx* osc_net_rx_create (int fd, size_t batch, size_t mtu) {
+
+    if (fd < 0 || batch == 0 || mtu == 0) {
+        return NULL;
+    }
+
+    OscNetRx* rx = (OscNetRx*)osc_malloc(sizeof(OscNetRx));
+    if (!rx) {
+        return NULL;
+    }
+
+    rx->fd    = fd;
+    rx->batch = batch;
+    rx->mtu   = mtu;
+    rx->count = 0;
+    rx->mode  = OSC_PARSE_LENIENT;
+
+    rx->slab  = (uint8_t*)osc_malloc(batch * mtu);
+    rx->msgs  = (struct mmsghdr*)osc_malloc(batch * sizeof(struct mmsghdr));
+    rx->iovs  = (struct iovec*)osc_malloc(batch * sizeof(struct iovec));
+    rx->addrs = (struct sockaddr_storage*)osc_malloc(batch * sizeof(struct sockaddr_storage));
+
+    if (!rx->slab || !rx->msgs || !rx->iovs || !rx->addrs) {
+        return osc_net_rx_delete(rx);
+    }
+
+    // Bind message headers to the slab
+    memset((void*)rx->msgs, 0, batch * sizeof(struct mmsghdr));
+    for (size_t i=0; i<batch; ++i) {
+        rx->iovs[i].iov_base = &rx->slab[i * mtu];
+        rx->iovs[i].iov_len  = mtu;
+    }
+
+    return rx;
+}
+
+OscNetRx* osc_net_rx_delete (OscNetRx* rx) {
+
+    if (!rx) {
+        return NULL;
+    }
+
+    if (rx->slab)  osc_free((void*)rx->slab);
+    if (rx->msgs)  osc_free((void*)rx->msgs);
+    if (rx->iovs)  osc_free((void*)rx->iovs);
+    if (rx->addrs) osc_free((void*)rx->addrs);
+
+    osc_free((void*)rx);
+
+    return NULL;
+}
+
+void osc_net_rx_mode (OscNetRx* rx, int mode) {
+    rx->mode = mode;
+}
+
+// ============================================================================
+
+int osc_net_rx_recv (OscNetRx* rx, OscArena* arena,
+                     OscBundle** bundles, size_t count, int flags) {
+
+    if (count > rx->batch) {
+        count = rx->batch;
+    }
+
+    // Reset headers, the kernel overwrites lengths
+    for (size_t i=0; i<count; ++i) {
+        struct msghdr* hdr = &rx->msgs[i].msg_hdr;
+
+        hdr->msg_name       = &rx->addrs[i];
+        hdr->msg_namelen    = sizeof(struct sockaddr_storage);
+        hdr->msg_iov        = &rx->iovs[i];
+        hdr->msg_iovlen     = 1;
+        hdr->msg_control    = NULL;
+        hdr->msg_controllen = 0;
+        hdr->msg_flags      = 0;
+
+        rx->msgs[i].msg_len = 0;
+    }
+
+    // Receive, never wait for more than the first datagram
+    int res;
+    do {
+        res = recvmmsg(rx->fd, rx->msgs, (unsigned int)count, flags | MSG_WAITFORONE, NULL);
+    } while (res < 0 && errno == EINTR);
+
+    if (res < 0) {
+        rx->count = 0;
+        return -1;
+    }
+
+    rx->count = (size_t)res;
+
+    // Raw receive
+    if (!bundles) {
+        return res;
+    }
+
+    // Parse the batch
+    for (size_t i=0; i<rx->count; ++i) {
+
+        if (rx->msgs[i].msg_hdr.msg_flags & MSG_TRUNC) {
+            bundles[i] = NULL;
+            continue;
+        }
+
+        bundles[i] = osc_parse_result(arena, (const uint8_t*)rx->iovs[i].iov_base,
+                                      rx->msgs[i].msg_len, rx->mode, NULL);
+    }
+
+    return res;
+}
+
+const uint8_t* osc_net_rx_data (const OscNetRx* rx, size_t index, size_t* psize) {
+
+    if (index >= rx->count) {
+        return NULL;
+    }
+
+    if (psize) {
+        *psize = rx->msgs[index].msg_len;
+    }
+
+    return (const uint8_t*)rx->iovs[index].iov_base;
+}
+
+const struct sockaddr_storage* osc_net_rx_source (const OscNetRx* rx, size_t index) {
+
+    if (index >= rx->count) {
+        return NULL;
+    }
+
+    return &rx->addrs[index];
+}
+
+// ============================================================================
+
+static uint64_t osc_net_clock (void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// Sends queued datagrams, leaves slots allocated
+static int osc_net_tx_send (OscNetTx* tx) {
+
+    int    err = 0;
+    size_t ptr = 0;
+
+    while (ptr < tx->queued) {
+
+        int res = sendmmsg(tx->fd, &tx->msgs[ptr],
+                           (unsigned int)(tx->queued - ptr), 0);
+
+        if (res < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            err = -1;
+
+            // Socket buffer full, drop the rest rather than retrying each
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                tx->dropped += tx->queued - ptr;
+                break;
+            }
+
+            // Drop the failing datagram and carry on
+            tx->dropped++;
+            ptr++;
+        }
+        else {
+            ptr += (size_t)res;
+        }
+    }
+
+    tx->queued = 0;
+    return err;
+}
+
+// ============================================================================
+
+OscNetTx* osc_net_tx_create (int fd, size_t slots, size_t mtu, size_t depth) {
+
+    if (fd < 0 || slots == 0 || mtu == 0 || depth == 0) {
+        return NULL;
+    }
+
+    OscNetTx* tx = (OscNetTx*)osc_malloc(sizeof(OscNetTx));
+    if (!tx) {
+        return NULL;
+    }
+
+    tx->fd          = fd;
+    tx->slots       = slots;
+    tx->mtu         = mtu;
+    tx->depth       = depth;
+    tx->used        = 0;
+    tx->queued      = 0;
+    tx->dropped     = 0;
+    tx->flush_count = 0;
+    tx->flush_ns    = 0;
+    tx->deadline    = 0;
+
+    tx->slab  = (uint8_t*)osc_malloc(slots * mtu);
+    tx->msgs  = (struct mmsghdr*)osc_malloc(depth * sizeof(struct mmsghdr));
+    tx->iovs  = (struct iovec*)osc_malloc(depth * sizeof(struct iovec));
+    tx->addrs = (OscNetAddr*)osc_malloc(depth * sizeof(OscNetAddr));
+
+    if (!tx->slab || !tx->msgs || !tx->iovs || !tx->addrs) {
+        return osc_net_tx_delete(tx);
+    }
+
+    memset((void*)tx->msgs, 0, depth * sizeof(struct mmsghdr));
+    return tx;
+}
+
+OscNetTx* osc_net_tx_delete (OscNetTx* tx) {
+
+    if (!tx) {
+        return NULL;
+    }
+
+    if (tx->slab)  osc_free((void*)tx->slab);
+    if (tx->msgs)  osc_free((void*)tx->msgs);
+    if (tx->iovs)  osc_free((void*)tx->iovs);
+    if (tx->addrs) osc_free((void*)tx->addrs);
+
+    osc_free((void*)tx);
+
+    return NULL;
+}
+
+size_t osc_net_tx_dropped (const OscNetTx* tx) {
+    return tx->dropped;
+}
+
+void osc_net_tx_policy (OscNetTx* tx, size_t count, uint64_t timeout_ns) {
+    tx->flush_count = count;
+    tx->flush_ns    = timeout_ns;
+}
+
+// ============================================================================
+
+// Returns the next free slot, flushes when all are in use
+static uint8_t* osc_net_tx_slot (OscNetTx* tx, int* perr) {
+
+    if (tx->used == tx->slots) {
+        *perr |= osc_net_tx_flush(tx);
+    }
+
+    return &tx->slab[tx->used * tx->mtu];
+}
+
+// Takes the slot and queues a datagram per destination, all sharing it
+static int osc_net_tx_commit (OscNetTx* tx, uint8_t* slot, size_t size,
+                              const OscNetAddr* dests, size_t count) {
+
+    int err = 0;
+
+    tx->used++;
+
+    // Arm the deadline
+    if (tx->queued == 0 && tx->flush_ns) {
+        tx->deadline = osc_net_clock() + tx->flush_ns;
+    }
+
+    for (size_t i=0; i<count; ++i) {
+
+        if (tx->queued == tx->depth) {
+            err |= osc_net_tx_send(tx);
+        }
+
+        struct iovec*  iov  = &tx->iovs[tx->queued];
+        struct msghdr* hdr  = &tx->msgs[tx->queued].msg_hdr;
+        OscNetAddr*    addr = &tx->addrs[tx->queued];
+
+        iov->iov_base = slot;
+        iov->iov_len  = size;
+
+        // Kept until sent, the caller may reuse dests right away
+        *addr = dests[i];
+
+        hdr->msg_name       = (void*)&addr->addr;
+        hdr->msg_namelen    = addr->len;
+        hdr->msg_iov        = iov;
+        hdr->msg_iovlen     = 1;
+        hdr->msg_control    = NULL;
+        hdr->msg_controllen = 0;
+        hdr->msg_flags      = 0;
+
+        tx->queued++;
+    }
+
+    // Flush policy
+    if (tx->flush_count && tx->queued >= tx->flush_count) {
+        err |= osc_net_tx_flush(tx);
+    }
+    else {
+        err |= osc_net_tx_poll(tx);
+    }
+
+    return err;
+}
+
+int osc_net_tx_queue (OscNetTx* tx, const uint8_t* data, size_t size,
+                      const OscNetAddr* dests, size_t count) {
+
+    int err = 0;
+
+    if (size > tx->mtu) {
+        errno = EMSGSIZE;
+        return -1;
+    }
+
+    uint8_t* slot = osc_net_tx_slot(tx, &err);
+    memcpy(slot, data, size);
+
+    return osc_net_tx_commit(tx, slot, size, dests, count) | err;
+}
+
+int osc_net_tx_queue_message (OscNetTx* tx, const OscMessage* msg,
+                              const OscNetAddr* dests, size_t count) {
+
+    int    err  = 0;
+    size_t size = 0;
+
+    // Encode straight into the slot
+    uint8_t* slot = osc_net_tx_slot(tx, &err);
+    if (osc_encode_message_into(msg, slot, tx->mtu, &size)) {
+        errno = size ? EMSGSIZE : EINVAL;
+        return -1;
+    }
+
+    return osc_net_tx_commit(tx, slot, size, dests, count) | err;
+}
+
+int osc_net_tx_queue_bundle (OscNetTx* tx, const OscBundle* bundle,
+                             const OscNetAddr* dests, size_t count) {
+
+    int    err  = 0;
+    size_t size = 0;
+
+    // Encode straight into the slot
+    uint8_t* slot = osc_net_tx_slot(tx, &err);
+    if (osc_encode_bundle_into(bundle, slot, tx->mtu, &size)) {
+        errno = size ? EMSGSIZE : EINVAL;
+        return -1;
+    }
+
+    return osc_net_tx_commit(tx, slot, size, dests, count) | err;
+}
+
+int osc_net_tx_flush (OscNetTx* tx) {
+
+    int err = osc_net_tx_send(tx);
+    tx->used = 0;
+
+    return err;
+}
+
+int osc_net_tx_poll (OscNetTx* tx) {
+
+    if (tx->queued == 0 || tx->flush_ns == 0) {
+        return 0;
+    }
+
+    if (osc_net_clock() < tx->deadline) {
+        return 0;
+    }
+
+    return osc_net_tx_flush(tx);
+}
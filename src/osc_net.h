@@ -0,0 +1,100 @@
+#ifndef OSC_NET_H
+#define OSC_NET_H
+
+#include "osc.h"
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+// ============================================================================
+
+// Batched datagram receiver
+typedef struct _OscNetRx OscNetRx;
+
+OscNetRx* osc_net_rx_create (int fd, size_t batch, size_t mtu);
+OscNetRx* osc_net_rx_delete (OscNetRx* rx);
+
+// Receives up to count datagrams with a single syscall and parses each of
+// them into bundles[i], NULL for malformed or truncated ones. Bundles are
+// allocated from the arena when given, with NULL bundles nothing is parsed.
+// Returns the number of datagrams received or -1 on error (errno is set).
+// Flags are passed to recvmmsg() with MSG_WAITFORONE added, so a blocking
+// socket waits for the first datagram only and returns what is pending.
+//
+// Parsed blobs point into the receive buffers, which the next call
+// overwrites, unless the parse mode includes OSC_PARSE_COPY_BLOBS.
+int osc_net_rx_recv (OscNetRx* rx, OscArena* arena,
+                     OscBundle** bundles, size_t count, int flags);
+
+// Parse mode of received datagrams (OSC_PARSE_*), lenient by default
+void osc_net_rx_mode (OscNetRx* rx, int mode);
+
+// Raw data and source address of a datagram from the last batch
+const uint8_t* osc_net_rx_data (const OscNetRx* rx, size_t index, size_t* psize);
+const struct sockaddr_storage* osc_net_rx_source (const OscNetRx* rx, size_t index);
+
+// ============================================================================
+
+// Datagram destination
+typedef struct _OscNetAddr {
+
+    struct sockaddr_storage addr;
+    socklen_t               len;
+
+} OscNetAddr;
+
+// Batched datagram sender
+typedef struct _OscNetTx OscNetTx;
+
+// Packets are copied into a ring of slots buffers of mtu bytes each. Up to
+// depth datagrams (packet & destination pairs) are queued between flushes.
+OscNetTx* osc_net_tx_create (int fd, size_t slots, size_t mtu, size_t depth);
+OscNetTx* osc_net_tx_delete (OscNetTx* tx);
+
+// Flushes once count datagrams are queued and/or when the oldest queued
+// datagram is older than timeout_ns. Zero disables the respective policy.
+void osc_net_tx_policy (OscNetTx* tx, size_t count, uint64_t timeout_ns);
+
+// Queue a packet to be sent to each of the destinations. The destinations
+// are copied, they need not outlive the call. Returns -1 when the packet
+// does not fit a slot or a flush failed.
+int osc_net_tx_queue (OscNetTx* tx, const uint8_t* data, size_t size,
+                      const OscNetAddr* dests, size_t count);
+
+int osc_net_tx_queue_message (OscNetTx* tx, const OscMessage* msg,
+                              const OscNetAddr* dests, size_t count);
+int osc_net_tx_queue_bundle  (OscNetTx* tx, const OscBundle* bundle,
+                              const OscNetAddr* dests, size_t count);
+
+// Sends everything queued. Datagrams that fail to send are dropped, -1 is
+// returned if there were any. When a non-blocking socket would block, the
+// rest of the batch is dropped at once.
+int osc_net_tx_flush (OscNetTx* tx);
+
+// Datagrams dropped so far
+size_t osc_net_tx_dropped (const OscNetTx* tx);
+
+// Flushes if the timeout policy has expired, call periodically
+int osc_net_tx_poll (OscNetTx* tx);
+
+// ============================================================================
+
+// Strings and blobs at least this long are referenced rather than copied
+#ifndef OSC_IOV_MIN_REF
+#define OSC_IOV_MIN_REF 64
+#endif
+
+// Scatter-gather encoding for writev() / sendmsg(). Generated bytes (headers,
+// numbers, padding) are written to the scratch buffer, long strings and blobs
+// point to the message memory which must stay valid until sent. Returns -1 if the
+// input is invalid or the iovec array or scratch buffer are too small.
+int osc_encode_message_iov (const OscMessage* msg,
+                            struct iovec* iov, size_t max_iov, size_t* pnum_iov,
+                            uint8_t* scratch, size_t cap, size_t* psize);
+int osc_encode_bundle_iov  (const OscBundle* bundle,
+                            struct iovec* iov, size_t max_iov, size_t* pnum_iov,
+                            uint8_t* scratch, size_t cap, size_t* psize);
+
+// ============================================================================
+
+#endif // OSC_NET_H
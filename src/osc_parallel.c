@@ -0,0 +1,295 @@
+#include "osc.h"
+#include "osc_parse.h"
+#include "osc_stats.h"
+
+#include <pthread.h>
+#include <string.h>
+
+// ============================================================================
+
+// Element batches per thread, small enough to even out uneven elements
+#define OSC_PARALLEL_BATCHES    8
+
+// Element of the outer bundle
+typedef struct _OscParseTask {
+
+    const uint8_t*  data;
+    size_t          size;
+
+    OscMessage*     msg;        // Result, one of msg / bundle
+    OscBundle*      bundle;
+    size_t          elements;   // Nested elements
+
+} OscParseTask;
+
+struct _OscParser {
+
+    pthread_t*      threads;
+    size_t          num_threads;
+
+    pthread_mutex_t lock;
+    pthread_cond_t  start;      // New job or stop
+    pthread_cond_t  done;       // Last worker finished the job
+    uint64_t        job;        // Job counter
+    size_t          active;     // Workers still in the current job
+    int             stop;
+
+    // Current job
+    OscParseTask*   tasks;
+    size_t          num_tasks;
+    size_t          max_tasks;
+    size_t          next;       // Next task to take, atomic
+    size_t          batch;      // Tasks taken at once
+    int             failed;     // Atomic
+};
+
+// ============================================================================
+
+static void osc_parser_run (OscParser* parser) {
+
+    const size_t num_tasks = parser->num_tasks;
+    const size_t batch     = parser->batch;
+
+    for (;;) {
+        size_t first = __atomic_fetch_add(&parser->next, batch, __ATOMIC_RELAXED);
+        if (first >= num_tasks) {
+            break;
+        }
+
+        size_t last = first + batch < num_tasks ? first + batch : num_tasks;
+        for (size_t i=first; i<last; ++i) {
+
+            // Give up early, the results are discarded
+            if (__atomic_load_n(&parser->failed, __ATOMIC_RELAXED)) {
+                return;
+            }
+
+            OscParseTask* task = &parser->tasks[i];
+            if (osc_parse_element(task->data, task->size, 2, &task->elements,
+                                  &task->msg, &task->bundle)) {
+                __atomic_store_n(&parser->failed, 1, __ATOMIC_RELAXED);
+            }
+        }
+    }
+}
+
+static void* osc_parser_worker (void* arg) {
+
+    OscParser* parser = (OscParser*)arg;
+    uint64_t   seen   = 0;
+
+    pthread_mutex_lock(&parser->lock);
+
+    for (;;) {
+        while (!parser->stop && parser->job == seen) {
+            pthread_cond_wait(&parser->start, &parser->lock);
+        }
+
+        if (parser->stop) {
+            break;
+        }
+
+        seen = parser->job;
+        pthread_mutex_unlock(&parser->lock);
+
+        osc_parser_run(parser);
+
+        pthread_mutex_lock(&parser->lock);
+        if (--parser->active == 0) {
+            pthread_cond_signal(&parser->done);
+        }
+    }
+
+    pthread_mutex_unlock(&parser->lock);
+    return NULL;
+}
+
+// ============================================================================
+
+OscParser* osc_parser_create (size_t num_threads) {
+
+    OscParser* parser = (OscParser*)osc_malloc(sizeof(OscParser));
+    if (!parser) {
+        return NULL;
+    }
+
+    memset((void*)parser, 0, sizeof(OscParser));
+    pthread_mutex_init(&parser->lock, NULL);
+    pthread_cond_init(&parser->start, NULL);
+    pthread_cond_init(&parser->done, NULL);
+
+    if (num_threads) {
+        parser->threads = (pthread_t*)osc_malloc(num_threads * sizeof(pthread_t));
+        if (!parser->threads) {
+            return osc_parser_delete(parser);
+        }
+    }
+
+    for (size_t i=0; i<num_threads; ++i) {
+        if (pthread_create(&parser->threads[i], NULL, osc_parser_worker, parser)) {
+            return osc_parser_delete(parser);
+        }
+        parser->num_threads++;
+    }
+
+    return parser;
+}
+
+OscParser* osc_parser_delete (OscParser* parser) {
+
+    if (!parser) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&parser->lock);
+    parser->stop = 1;
+    pthread_cond_broadcast(&parser->start);
+    pthread_mutex_unlock(&parser->lock);
+
+    for (size_t i=0; i<parser->num_threads; ++i) {
+        pthread_join(parser->threads[i], NULL);
+    }
+
+    pthread_cond_destroy(&parser->done);
+    pthread_cond_destroy(&parser->start);
+    pthread_mutex_destroy(&parser->lock);
+
+    if (parser->threads) osc_free((void*)parser->threads);
+    if (parser->tasks)   osc_free((void*)parser->tasks);
+    osc_free((void*)parser);
+
+    return NULL;
+}
+
+// ============================================================================
+
+// Splits the outer bundle into tasks. Returns -1 when the packet should be
+// left to the serial parser (not a bundle, malformed framing or limits).
+static int osc_parser_frame (OscParser* parser, const uint8_t* data, size_t size) {
+
+    const uint8_t magic[] = {'#', 'b', 'u', 'n', 'd', 'l', 'e', 0};
+
+    if (size < 16 || size > OSC_PARSE_MAX_SIZE || memcmp(data, magic, sizeof(magic))) {
+        return -1;
+    }
+
+    parser->num_tasks = 0;
+
+    for (size_t ptr=16; ptr < size; ) {
+
+        if (size - ptr < 4 || parser->num_tasks >= OSC_PARSE_MAX_ELEMENTS) {
+            return -1;
+        }
+
+        size_t len = ((size_t)data[ptr + 0] << 24) | ((size_t)data[ptr + 1] << 16) |
+                     ((size_t)data[ptr + 2] <<  8) |  (size_t)data[ptr + 3];
+        ptr += 4;
+
+        if (len > size - ptr) {
+            return -1;
+        }
+
+        // Grow the task table, kept between parses
+        if (parser->num_tasks == parser->max_tasks) {
+            size_t max_tasks = parser->max_tasks ? parser->max_tasks * 2 : 64;
+
+            OscParseTask* tasks = (OscParseTask*)osc_malloc(max_tasks * sizeof(OscParseTask));
+            if (!tasks) {
+                return -1;
+            }
+
+            if (parser->tasks) {
+                memcpy(tasks, parser->tasks, parser->num_tasks * sizeof(OscParseTask));
+                osc_free((void*)parser->tasks);
+            }
+
+            parser->tasks     = tasks;
+            parser->max_tasks = max_tasks;
+        }
+
+        OscParseTask* task = &parser->tasks[parser->num_tasks++];
+        task->data     = &data[ptr];
+        task->size     = len;
+        task->msg      = NULL;
+        task->bundle   = NULL;
+        task->elements = 0;
+
+        ptr += len;
+    }
+
+    // Not worth waking the workers
+    return parser->num_tasks < 2 ? -1 : 0;
+}
+
+OscBundle* osc_parse_parallel (OscParser* parser, const uint8_t* data, size_t size) {
+
+    if (!parser || size < OSC_PARALLEL_MIN_SIZE || osc_parser_frame(parser, data, size)) {
+        return osc_parse(data, size);
+    }
+
+    OSC_STAT_START(start);
+
+    size_t workers = parser->num_threads + 1;
+    size_t batch   = parser->num_tasks / (workers * OSC_PARALLEL_BATCHES);
+
+    parser->next   = 0;
+    parser->batch  = batch ? batch : 1;
+    parser->failed = 0;
+
+    // Wake the workers and take part
+    pthread_mutex_lock(&parser->lock);
+    parser->job++;
+    parser->active = parser->num_threads;
+    pthread_cond_broadcast(&parser->start);
+    pthread_mutex_unlock(&parser->lock);
+
+    osc_parser_run(parser);
+
+    pthread_mutex_lock(&parser->lock);
+    while (parser->active) {
+        pthread_cond_wait(&parser->done, &parser->lock);
+    }
+    pthread_mutex_unlock(&parser->lock);
+
+    // Element limit over the whole packet
+    size_t elements = parser->num_tasks;
+    for (size_t i=0; i<parser->num_tasks; ++i) {
+        elements += parser->tasks[i].elements;
+    }
+
+    if (!parser->failed && elements > OSC_PARSE_MAX_ELEMENTS) {
+        OSC_STAT_REJECT(OSC_ERR_LIMIT);
+        parser->failed = 1;
+    }
+
+    int64_t    timestamp = 0;
+    OscBundle* bundle    = NULL;
+
+    if (!parser->failed) {
+        for (size_t i=8; i<16; ++i) {
+            timestamp = (int64_t)(((uint64_t)timestamp << 8) | data[i]);
+        }
+        bundle = osc_bundle_create(timestamp);
+    }
+
+    // Link in wire order like the serial parser, or release on failure
+    for (size_t i=0; i<parser->num_tasks; ++i) {
+        OscParseTask* task = &parser->tasks[i];
+
+        if (!bundle) {
+            osc_message_delete(task->msg);
+            osc_bundle_delete(task->bundle);
+        }
+        else if (task->msg) {
+            task->msg->next  = bundle->messages;
+            bundle->messages = task->msg;
+        }
+        else {
+            task->bundle->next = bundle->bundles;
+            bundle->bundles    = task->bundle;
+        }
+    }
+
+    OSC_STAT_PARSED(start, size, bundle != NULL);
+    return bundle;
+}
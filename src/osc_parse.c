@@ -1,173 +1,429 @@
 #include "osc.h"
+#include "osc_parse.h"
+#include "osc_plan.h"
+#include "osc_pool.h"
+#include "osc_simd.h"
+#include "osc_stats.h"
 
 #include <string.h>
 
 // ============================================================================
 
-static OscMessage* osc_parse_message (const uint8_t* data, size_t size) {
+// Returns the offset past the NUL terminator of a string starting at ptr or
+// 0 when the string is not terminated within the buffer
+static size_t osc_parse_string (const uint8_t* data, size_t size, size_t ptr) {
+    return osc_simd_scan(data, size, ptr);
+}
+
+// Parses the address and the tag string. Returns the offset of the first
+// argument or 0 on error
+static size_t osc_parse_header (const uint8_t* data, size_t size,
+                                const char** paddr, const char** ptags) {
 
     // Sanity check
     if (size == 0 || data[0] != '/') {
-        return NULL;
+        return 0;
     }
 
-    OscMessage* msg = NULL;
-    size_t      ptr = 0;
-
     // Find the address/tag string boundary
-    for (; data[ptr] != 0; ++ptr) {
-        if (ptr >= size) {
-            return NULL;
-        }
+    size_t ptr = osc_parse_string(data, size, 0);
+    if (!ptr) {
+        return 0;
     }
-    ptr++;
 
     // Align pointer to 4
     if (ptr & 3) ptr = (ptr & ~3) + 4;
 
     // The tag string should begin with ','
     if (ptr >= size || data[ptr] != ',') {
-        return NULL;
+        return 0;
     }
 
     ptr++;
     size_t tags_ptr = ptr;
 
     // Find the arguments pointer
-    for (; data[ptr] != 0; ++ptr) {
-        if (ptr >= size) {
-            return NULL;
+    ptr = osc_parse_string(data, size, ptr);
+    if (!ptr) {
+        return 0;
+    }
+
+    *paddr = (const char*)&data[0];
+    *ptags = (const char*)&data[tags_ptr];
+
+    return ptr;
+}
+
+// Reason and offset of an osc_parse_header() failure
+static int osc_parse_header_fault (const uint8_t* data, size_t size, size_t* poffset) {
+
+    *poffset = 0;
+    if (size == 0 || data[0] != '/') {
+        return OSC_ERR_ADDRESS;
+    }
+
+    size_t ptr = osc_parse_string(data, size, 0);
+    if (!ptr) {
+        return OSC_ERR_ADDRESS;
+    }
+
+    if (ptr & 3) ptr = (ptr & ~3) + 4;
+    *poffset = ptr;
+
+    return OSC_ERR_TAGS;
+}
+
+// Decodes a single argument at *pptr and advances the pointer past it.
+// Strings are not copied, they point into the data buffer. With a NULL arg
+// the argument is only checked.
+static int osc_parse_argument (char tag, const uint8_t* data, size_t size,
+                               size_t* pptr, OscArgument* arg) {
+
+    size_t ptr = *pptr;
+
+    // Align pointer to 4
+    if (ptr & 3) ptr = (ptr & ~3) + 4;
+
+    // Argument size
+    size_t arg_size = 0;
+    switch (tag) {
+
+        case 'i':
+        case 'f':
+            arg_size = 4;
+            break;
+
+        case 'h':
+        case 'd':
+            arg_size = 8;
+            break;
+
+        case 'c':
+        case 'r':
+        case 'm':
+            arg_size = 4;
+            break;
+
+        case 't':
+            arg_size = 8;
+            break;
+
+        case 'T':
+        case 'F':
+        case 'N':
+        case 'I':
+        case '[':
+        case ']':
+            break;
+
+        case 's':
+        case 'S':
+            arg_size = osc_parse_string(data, size, ptr);
+            if (!arg_size) {
+                return -1;
+            }
+            arg_size -= ptr;
+            break;
+
+        case 'b':
+            if (size < 4 || ptr > size - 4) {
+                return -1;
+            }
+            arg_size = 4 + (((size_t)data[ptr + 0] << 24) |
+                            ((size_t)data[ptr + 1] << 16) |
+                            ((size_t)data[ptr + 2] <<  8) |
+                            ((size_t)data[ptr + 3]));
+            break;
+
+        // Unknown, error
+        default:
+            return -1;
+    }
+
+    // Check
+    if ((ptr + arg_size) > size) {
+        return -1;
+    }
+
+    if (!arg) {
+        *pptr = ptr + arg_size;
+        return 0;
+    }
+
+    // Decode
+    switch (tag) {
+
+        // 32-bit
+        case 'i':
+        case 'f':
+        case 'r':
+        case 'm':
+            for (size_t j=0; j<4; ++j) {
+                arg->b[3 - j] = data[ptr + j];
+            }
+            break;
+
+        // 64-bit
+        case 'h':
+        case 'd':
+        case 't':
+            for (size_t j=0; j<8; ++j) {
+                arg->b[7 - j] = data[ptr + j];
+            }
+            break;
+
+        // char as 32-bit
+        case 'c':
+            arg->i32 = data[ptr + 3] & 0x7F;
+            break;
+
+        // True
+        case 'T':
+            arg->i32 = 1;
+            break;
+
+        // False / Null / array delimiters
+        case 'F':
+        case 'N':
+        case '[':
+        case ']':
+            arg->i32 = 0;
+            break;
+
+        // Infinity
+        case 'I':
+            arg->f32 = 0x7F800000; // IEEE 754 +Inf
+            break;
+
+        // String
+        case 's':
+        case 'S':
+            arg->str = (char*)&data[ptr];
+            break;
+
+        // Blob
+        case 'b':
+            arg->blob.data = &data[ptr + 4];
+            arg->blob.size = (int32_t)(arg_size - 4);
+            break;
+    }
+
+    // Next
+    *pptr = ptr + arg_size;
+    return 0;
+}
+
+static uint32_t osc_read32 (const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+           ((uint32_t)p[2] <<  8) |  (uint32_t)p[3];
+}
+
+static uint64_t osc_read64 (const uint8_t* p) {
+    return ((uint64_t)osc_read32(p) << 32) | osc_read32(p + 4);
+}
+
+// Width of numeric tags converted in bulk, 0 for others
+static size_t osc_parse_width (char tag) {
+
+    switch (tag) {
+        case 'i':
+        case 'f':
+        case 'r':
+        case 'm':
+            return 4;
+
+        case 'h':
+        case 'd':
+        case 't':
+            return 8;
+    }
+
+    return 0;
+}
+
+// Decodes arguments one by one, runs of numeric arguments in bulk. Array
+// balance is checked when check_arrays is set. Returns the offset past the
+// last argument or 0 on error.
+static size_t osc_parse_generic (const char* tags, size_t num_args,
+                              const uint8_t* data, size_t size, size_t ptr,
+                              OscArgument* args, int check_arrays) {
+
+    int depth = 0;
+    for (size_t i=0; i<num_args; ) {
+
+        // Run of same width numeric arguments
+        size_t width = osc_parse_width(tags[i]);
+        size_t count = 0;
+        if (width) {
+            while (i + count < num_args && osc_parse_width(tags[i + count]) == width) {
+                count++;
+            }
+        }
+
+        if (count >= OSC_SIMD_MIN_RUN) {
+            if (ptr & 3) ptr = (ptr & ~3) + 4;
+            if (ptr > size || count > (size - ptr) / width) {
+                return 0;
+            }
+
+            if (args) {
+                if (width == 4) osc_simd_load32(&args[i], &data[ptr], count);
+                else            osc_simd_load64(&args[i], &data[ptr], count);
+            }
+
+            ptr += count * width;
+            i   += count;
+            continue;
+        }
+
+        if (check_arrays) {
+            if (tags[i] == '[') depth++;
+            if (tags[i] == ']' && --depth < 0) return 0;
+        }
+
+        if (osc_parse_argument(tags[i], data, size, &ptr, args ? &args[i] : NULL)) {
+            return 0;
         }
+
+        i++;
     }
 
-    ptr++;
+    return depth ? 0 : ptr;
+}
 
-    // Create the message
-    const char* addr_str = (const char*)&data[0];
-    const char* tags_str = (const char*)&data[tags_ptr];
+// Decodes all arguments starting at ptr. Strings and blobs point into the
+// data buffer. With NULL args the arguments are only checked. Returns the
+// offset past the last argument or 0 on error.
+static size_t osc_parse_arguments (const char* tags, size_t num_args,
+                                const uint8_t* data, size_t size, size_t ptr,
+                                OscArgument* args) {
 
-    msg = osc_message_create(tags_str);
-    msg->addr = osc_strdup(addr_str);
+    const OscPlan* plan = osc_plan_get(tags, num_args);
 
-    // Parse arguments
-    for (size_t i=0; i<strlen(msg->tags); ++i) {
+    // Tag string too long for a plan, check arrays here
+    if (!plan) {
+        return osc_parse_generic(tags, num_args, data, size, ptr, args, 1);
+    }
 
-        // Align pointer to 4
-        if (ptr & 3) ptr = (ptr & ~3) + 4;
+    if (!plan->valid) {
+        return 0;
+    }
 
-        // Argument size
-        size_t arg_size = 0;
-        switch (msg->tags[i]) {
-
-            case 'i':
-            case 'f':
-                arg_size = 4;
-                break;
-
-            case 'h':
-            case 'd':
-                arg_size = 8;
-                break;
-
-            case 'c':
-            case 'r':
-            case 'm':
-                arg_size = 4;
-                break;
-
-            case 't':
-                arg_size = 8;
-                break;
-
-            case 'T':
-            case 'F':
-            case 'N':
-            case 'I':
-                break;
-
-            case 's':
-            case 'S':
-                for (size_t p=ptr; data[p] != 0 && p < size; ++p) {
-                    arg_size++;
-                }
-                arg_size += 1;
-                break;
-
-            // Unknown, error
-            default:
-                osc_message_delete(msg);
-                return NULL;
+    // Variable layout
+    if (!plan->fixed) {
+        return osc_parse_generic(tags, num_args, data, size, ptr, args, 0);
+    }
+
+    // Fixed layout, a single bounds check
+    if (ptr & 3) ptr = (ptr & ~3) + 4;
+    if (ptr > size || plan->size > size - ptr) {
+        return 0;
+    }
+
+    if (!args) {
+        return ptr + plan->size;
+    }
+
+    const uint8_t* base = &data[ptr];
+    for (size_t i=0; i<num_args; ++i) {
+        const OscPlanStep* step = &plan->steps[i];
+        const uint8_t*     src  = &base[step->offset];
+
+        switch (step->kind) {
+            case OSC_KIND_32:   args[i].i32 = (int32_t)osc_read32(src); break;
+            case OSC_KIND_64:   args[i].i64 = (int64_t)osc_read64(src); break;
+            case OSC_KIND_CHAR: args[i].i32 = src[3] & 0x7F;            break;
+            case OSC_KIND_TRUE: args[i].i32 = 1;                        break;
+            case OSC_KIND_INF:  args[i].f32 = 0x7F800000;               break;
+            default:            args[i].i32 = 0;                        break;
         }
+    }
 
-        // Check
-        if ((ptr + arg_size) > size) {
-            osc_message_delete(msg);
-            return NULL;
+    return ptr + plan->size;
+}
+
+// Locates the fault after osc_parse_arguments() failed. Returns the index of
+// the faulty argument (or of an unclosed array) and its offset.
+static int osc_parse_arguments_fault (const char* tags, size_t num_args,
+                                      const uint8_t* data, size_t size, size_t ptr,
+                                      size_t* poffset) {
+
+    int    depth = 0;
+    size_t open  = 0;
+
+    for (size_t i=0; i<num_args; ++i) {
+        if (ptr & 3) ptr = (ptr & ~3) + 4;
+        *poffset = ptr;
+
+        if (tags[i] == '[' && depth++ == 0) open = i;
+        if (tags[i] == ']' && --depth < 0) return (int)i;
+
+        if (osc_parse_argument(tags[i], data, size, &ptr, NULL)) {
+            return (int)i;
         }
+    }
+
+    return (int)open;
+}
+
+// ============================================================================
+
+static OscMessage* osc_parse_message (OscArena* arena,
+                                      const uint8_t* data, size_t size) {
+
+    const char* addr_str = NULL;
+    const char* tags_str = NULL;
+
+    // Parse address and tags
+    size_t ptr = osc_parse_header(data, size, &addr_str, &tags_str);
+    if (!ptr) {
+        OSC_STAT_REJECT(osc_parse_header_fault(data, size, &ptr));
+        return NULL;
+    }
+
+    // Create the message
+    OscMessage* msg = osc_message_create_ex(arena, tags_str);
+    msg->addr = osc_pool_strdup(arena, addr_str);
+
+    // Parse arguments
+    if (!osc_parse_arguments(msg->tags, msg->num_args, data, size, ptr, msg->args)) {
+        OSC_STAT_REJECT(OSC_ERR_ARGUMENT);
 
-        // Decode
-        switch (msg->tags[i]) {
-
-            // 32-bit
-            case 'i':
-            case 'f':
-            case 'r':
-            case 'm':
-                for (size_t j=0; j<4; ++j) {
-                    msg->args[i].b[3 - j] = data[ptr + j];
-                }
-                break;
-
-            // 64-bit
-            case 'h':
-            case 'd':
-            case 't':
-                for (size_t j=0; j<8; ++j) {
-                    msg->args[i].b[7 - j] = data[ptr + j];
-                }
-                break;
-
-            // char as 32-bit
-            case 'c':
-                msg->args[i].i32 = data[ptr + 3] & 0x7F;
-                break;
-
-            // True
-            case 'T':
-                msg->args[i].i32 = 1;
-                break;
-
-            // False / Null
-            case 'F':
-            case 'N':
-                msg->args[i].i32 = 0;
-                break;
-
-            // Infinity
-            case 'I':
-                msg->args[i].f32 = 0x7F800000; // IEEE 754 +Inf
-                break;
-
-            // String
-            case 's':
-            case 'S':
-                msg->args[i].str = osc_strdup((const char*)&data[ptr]);
-                break;
+        // Do not free borrowed strings
+        for (size_t i=0; i<msg->num_args; ++i) {
+            msg->args[i].str = NULL;
         }
 
-        // Next
-        ptr += arg_size;
+        if (!arena) osc_message_delete(msg);
+        return NULL;
+    }
+
+    // Strings are owned by the message
+    for (size_t i=0; i<msg->num_args; ++i) {
+        if (msg->tags[i] == 's' || msg->tags[i] == 'S') {
+            msg->args[i].str = osc_pool_strdup(arena, msg->args[i].str);
+        }
     }
 
     return msg;
 }
 
-static OscBundle* osc_parse_bundle (const uint8_t* data, size_t size) {
+// Parses a bundle at nesting depth (1 for the outermost), pelements counts
+// the elements of the whole packet
+static OscBundle* osc_parse_bundle (OscArena* arena,
+                                    const uint8_t* data, size_t size,
+                                    size_t depth, size_t* pelements) {
 
     const uint8_t magic[] = {'#', 'b', 'u', 'n', 'd', 'l', 'e', 0};
 
     // Too small to fit the header
     if (size < 16) {
+        OSC_STAT_REJECT(OSC_ERR_BUNDLE);
+        return NULL;
+    }
+
+    if (depth > OSC_PARSE_MAX_DEPTH) {
+        OSC_STAT_REJECT(OSC_ERR_LIMIT);
         return NULL;
     }
 
@@ -175,18 +431,29 @@ static OscBundle* osc_parse_bundle (const uint8_t* data, size_t size) {
     size_t ptr = 8;
 
     // Timestamp
-    int64_t timestamp = 0;
-    for (size_t i=0; i<8; ++i) {
-        timestamp <<= 8;
-        timestamp  |= data[ptr++];
-    }
+    int64_t timestamp = (int64_t)osc_read64(&data[ptr]);
+    ptr += 8;
 
     // Allocate the bundle
-    OscBundle* bundle = osc_bundle_create(timestamp);
+    OscBundle* bundle = osc_bundle_create_ex(arena, timestamp);
 
     // Parse bundle items
     while (ptr < size) {
 
+        int err = OSC_ERR_NONE;
+        if (size - ptr < 4) {
+            err = OSC_ERR_BUNDLE;
+        }
+        else if (++*pelements > OSC_PARSE_MAX_ELEMENTS) {
+            err = OSC_ERR_LIMIT;
+        }
+
+        if (err) {
+            OSC_STAT_REJECT(err);
+            if (!arena) osc_bundle_delete(bundle);
+            return NULL;
+        }
+
         // Size
         size_t len = 0;
         for (size_t i=0; i<4; ++i) {
@@ -194,6 +461,12 @@ static OscBundle* osc_parse_bundle (const uint8_t* data, size_t size) {
             len  |= data[ptr++];
         }
 
+        if (len > size - ptr) {
+            OSC_STAT_REJECT(OSC_ERR_BUNDLE);
+            if (!arena) osc_bundle_delete(bundle);
+            return NULL;
+        }
+
         // Check if the message is a bundle
         const int isBundle = (len > sizeof(magic)) &&
                              !memcmp(&data[ptr], magic, sizeof(magic));
@@ -201,9 +474,9 @@ static OscBundle* osc_parse_bundle (const uint8_t* data, size_t size) {
         // Got a bundle
         if (isBundle) {
 
-            OscBundle* bun = osc_parse_bundle(&data[ptr], len);
+            OscBundle* bun = osc_parse_bundle(arena, &data[ptr], len, depth + 1, pelements);
             if (!bun) {
-                osc_bundle_delete(bundle);
+                if (!arena) osc_bundle_delete(bundle);
                 return NULL;
             }
 
@@ -214,9 +487,9 @@ static OscBundle* osc_parse_bundle (const uint8_t* data, size_t size) {
         // Got a message
         else {
 
-            OscMessage* msg = osc_parse_message(&data[ptr], len);
+            OscMessage* msg = osc_parse_message(arena, &data[ptr], len);
             if (!msg) {
-                osc_bundle_delete(bundle);
+                if (!arena) osc_bundle_delete(bundle);
                 return NULL;
             }
 
@@ -231,9 +504,37 @@ static OscBundle* osc_parse_bundle (const uint8_t* data, size_t size) {
     return bundle;
 }
 
+int osc_parse_element (const uint8_t* data, size_t size, size_t depth, size_t* pelements,
+                       OscMessage** pmsg, OscBundle** pbundle) {
+
+    const uint8_t magic[] = {'#', 'b', 'u', 'n', 'd', 'l', 'e', 0};
+    const int isBundle = (size > sizeof(magic)) &&
+                         !memcmp(data, magic, sizeof(magic));
+
+    *pmsg    = NULL;
+    *pbundle = NULL;
+
+    if (isBundle) {
+        *pbundle = osc_parse_bundle(NULL, data, size, depth, pelements);
+        return *pbundle ? 0 : -1;
+    }
+
+    *pmsg = osc_parse_message(NULL, data, size);
+    return *pmsg ? 0 : -1;
+}
+
 // ============================================================================
 
 OscBundle* osc_parse (const uint8_t* data, size_t size) {
+    return osc_parse_ex(NULL, data, size);
+}
+
+static OscBundle* osc_parse_root (OscArena* arena, const uint8_t* data, size_t size) {
+
+    if (size > OSC_PARSE_MAX_SIZE) {
+        OSC_STAT_REJECT(OSC_ERR_LIMIT);
+        return NULL;
+    }
 
     // Check if the message is a bundle
     const uint8_t magic[] = {'#', 'b', 'u', 'n', 'd', 'l', 'e', 0};
@@ -242,18 +543,512 @@ OscBundle* osc_parse (const uint8_t* data, size_t size) {
 
     // Parse bundle
     if (isBundle) {
-        return osc_parse_bundle(data, size);
+        size_t elements = 0;
+        return osc_parse_bundle(arena, data, size, 1, &elements);
     }
 
     // Parse message and pack it into a Bundle
     else {
 
-        OscMessage* msg = osc_parse_message (data, size);
+        OscMessage* msg = osc_parse_message(arena, data, size);
         if (!msg) return NULL;
 
-        OscBundle* bundle = osc_bundle_create(OSC_IMMEDIATE);
+        OscBundle* bundle = osc_bundle_create_ex(arena, OSC_IMMEDIATE);
         bundle->messages = msg;
 
         return bundle;
     }
 }
+
+OscBundle* osc_parse_ex (OscArena* arena, const uint8_t* data, size_t size) {
+
+    OSC_STAT_START(start);
+
+    OscBundle* bundle = osc_parse_root(arena, data, size);
+
+    OSC_STAT_PARSED(start, size, bundle != NULL);
+    return bundle;
+}
+
+// ============================================================================
+
+// Flat parse output. With NULL tables only the counts are computed and
+// arguments are not decoded, only checked when check is set.
+typedef struct _OscTables {
+
+    OscBundleView*  bundles;
+    OscMessageView* messages;
+    OscArgument*    args;
+
+    size_t          max_bundles;
+    size_t          max_messages;
+    size_t          max_args;
+
+    size_t          num_bundles;
+    size_t          num_messages;
+    size_t          num_args;
+
+    int             check;      // Check arguments in count only mode
+    size_t          depth;      // Current bundle nesting depth
+    size_t          max_depth;  // Deepest bundle nesting
+    size_t          elements;   // Bundle elements so far
+    const char*     addr;       // First message address
+
+    int             mode;       // OSC_PARSE_*, strict checks need arguments walked
+    int             quiet;      // Do not count rejects, the fault is already counted
+    OscParseResult* result;     // First fault, may be NULL
+    size_t          base;       // Offset of the current element in the packet
+    size_t          path [OSC_PARSE_MAX_PATH];
+
+} OscTables;
+
+// Records a fault at offset in the current element, returns -1
+static int osc_parse_fail (OscTables* tab, int error, size_t offset, int arg) {
+
+    if (!tab->quiet) {
+        OSC_STAT_REJECT(error);
+    }
+
+    OscParseResult* res = tab->result;
+    if (res && res->error == OSC_ERR_NONE) {
+        res->error  = error;
+        res->offset = tab->base + offset;
+        res->depth  = tab->depth;
+        res->arg    = arg;
+
+        size_t n = tab->depth < OSC_PARSE_MAX_PATH ? tab->depth : OSC_PARSE_MAX_PATH;
+        memcpy(res->path, tab->path, n * sizeof(size_t));
+    }
+
+    return -1;
+}
+
+static int osc_parse_flat_message (const uint8_t* data, size_t size,
+                                   size_t bundle, OscTables* tab) {
+
+    if (tab->num_messages >= tab->max_messages) {
+        return osc_parse_fail(tab, OSC_ERR_LIMIT, 0, -1);
+    }
+
+    const char* addr = NULL;
+    const char* tags = NULL;
+
+    // Parse address and tags
+    size_t ptr = osc_parse_header(data, size, &addr, &tags);
+    if (!ptr) {
+        int err = osc_parse_header_fault(data, size, &ptr);
+        return osc_parse_fail(tab, err, ptr, -1);
+    }
+
+    size_t num_args = strlen(tags);
+    if (num_args > tab->max_args - tab->num_args) {
+        return osc_parse_fail(tab, OSC_ERR_LIMIT, 0, -1);
+    }
+
+    if (!tab->addr) {
+        tab->addr = addr;
+    }
+
+    // Decode arguments into the side table, or only check them
+    if (tab->messages || tab->check) {
+        OscArgument* args = tab->messages ? &tab->args[tab->num_args] : NULL;
+
+        size_t end = osc_parse_arguments(tags, num_args, data, size, ptr, args);
+        if (!end) {
+            int arg = osc_parse_arguments_fault(tags, num_args, data, size, ptr, &ptr);
+            return osc_parse_fail(tab, OSC_ERR_ARGUMENT, ptr, arg);
+        }
+
+        // Nothing but padding after the last argument
+        if ((tab->mode & OSC_PARSE_STRICT) && ((end + 3) & ~(size_t)3) != size) {
+            return osc_parse_fail(tab, OSC_ERR_SIZE, end, -1);
+        }
+
+        if (args) {
+            OscMessageView* msg = &tab->messages[tab->num_messages];
+            msg->addr   = addr;
+            msg->tags   = tags;
+            msg->args   = args;
+            msg->bundle = bundle;
+        }
+    }
+
+    tab->num_args += num_args;
+    tab->num_messages++;
+
+    return 0;
+}
+
+static int osc_parse_flat_bundle (const uint8_t* data, size_t size,
+                                  int parent, OscTables* tab) {
+
+    const uint8_t magic[] = {'#', 'b', 'u', 'n', 'd', 'l', 'e', 0};
+
+    // Too small to fit the header
+    if (size < 16) {
+        return osc_parse_fail(tab, OSC_ERR_BUNDLE, 0, -1);
+    }
+
+    if (tab->num_bundles >= tab->max_bundles) {
+        return osc_parse_fail(tab, OSC_ERR_LIMIT, 0, -1);
+    }
+
+    size_t index = tab->num_bundles++;
+    size_t first = tab->num_messages;
+
+    if (tab->depth >= OSC_PARSE_MAX_DEPTH) {
+        return osc_parse_fail(tab, OSC_ERR_LIMIT, 0, -1);
+    }
+
+    if (++tab->depth > tab->max_depth) {
+        tab->max_depth = tab->depth;
+    }
+
+    // Skip magic
+    size_t ptr = 8;
+
+    // Timestamp
+    int64_t timestamp = (int64_t)osc_read64(&data[ptr]);
+    ptr += 8;
+
+    // Parse bundle items
+    for (size_t element=0; ptr < size; ++element) {
+
+        if (tab->depth <= OSC_PARSE_MAX_PATH) {
+            tab->path[tab->depth - 1] = element;
+        }
+
+        // Size
+        if (size - ptr < 4) {
+            return osc_parse_fail(tab, OSC_ERR_BUNDLE, ptr, -1);
+        }
+
+        if (++tab->elements > OSC_PARSE_MAX_ELEMENTS) {
+            return osc_parse_fail(tab, OSC_ERR_LIMIT, ptr, -1);
+        }
+
+        size_t len = 0;
+        for (size_t i=0; i<4; ++i) {
+            len <<= 8;
+            len  |= data[ptr++];
+        }
+
+        if (len > size - ptr) {
+            return osc_parse_fail(tab, OSC_ERR_BUNDLE, ptr - 4, -1);
+        }
+
+        if ((tab->mode & OSC_PARSE_STRICT) && (len & 3)) {
+            return osc_parse_fail(tab, OSC_ERR_SIZE, ptr - 4, -1);
+        }
+
+        // Check if the message is a bundle
+        const int isBundle = (len > sizeof(magic)) &&
+                             !memcmp(&data[ptr], magic, sizeof(magic));
+
+        tab->base += ptr;
+
+        int res = isBundle ?
+            osc_parse_flat_bundle(&data[ptr], len, (int)index, tab) :
+            osc_parse_flat_message(&data[ptr], len, index, tab);
+
+        if (res) {
+            return -1;
+        }
+
+        tab->base -= ptr;
+
+        // Next
+        ptr += len;
+    }
+
+    // Messages of sub-bundles are included in the range
+    if (tab->bundles) {
+        OscBundleView* bundle = &tab->bundles[index];
+        bundle->timestamp = timestamp;
+        bundle->parent    = parent;
+        bundle->first     = first;
+        bundle->count     = tab->num_messages - first;
+    }
+
+    tab->depth--;
+    return 0;
+}
+
+static int osc_parse_flat (const uint8_t* data, size_t size, OscTables* tab) {
+
+    tab->num_bundles  = 0;
+    tab->num_messages = 0;
+    tab->num_args     = 0;
+    tab->depth        = 0;
+    tab->max_depth    = 0;
+    tab->elements     = 0;
+    tab->addr         = NULL;
+    tab->base         = 0;
+
+    if (size > OSC_PARSE_MAX_SIZE) {
+        return osc_parse_fail(tab, OSC_ERR_LIMIT, 0, -1);
+    }
+
+    // Check if the message is a bundle
+    const uint8_t magic[] = {'#', 'b', 'u', 'n', 'd', 'l', 'e', 0};
+    const int isBundle = (size > sizeof(magic)) &&
+                         !memcmp(data, magic, sizeof(magic));
+
+    // Parse bundle
+    if (isBundle) {
+        return osc_parse_flat_bundle(data, size, -1, tab);
+    }
+
+    // Parse message and wrap it in an immediate bundle
+    if (tab->max_bundles == 0) {
+        return osc_parse_fail(tab, OSC_ERR_LIMIT, 0, -1);
+    }
+
+    tab->num_bundles++;
+
+    if (osc_parse_flat_message(data, size, 0, tab)) {
+        return -1;
+    }
+
+    if (tab->bundles) {
+        OscBundleView* bundle = &tab->bundles[0];
+        bundle->timestamp = OSC_IMMEDIATE;
+        bundle->parent    = -1;
+        bundle->first     = 0;
+        bundle->count     = 1;
+    }
+
+    return 0;
+}
+
+// ============================================================================
+
+int osc_parse_view (const uint8_t* data, size_t size, OscView* view) {
+
+    OscTables tab;
+    tab.bundles      = view->bundles;
+    tab.messages     = view->messages;
+    tab.args         = view->args;
+    tab.max_bundles  = OSC_VIEW_MAX_BUNDLES;
+    tab.max_messages = OSC_VIEW_MAX_MESSAGES;
+    tab.max_args     = OSC_VIEW_MAX_ARGS;
+    tab.check        = 0;
+    tab.mode         = OSC_PARSE_LENIENT;
+    tab.quiet        = 0;
+    tab.result       = NULL;
+
+    OSC_STAT_START(start);
+
+    int res = osc_parse_flat(data, size, &tab);
+
+    OSC_STAT_PARSED(start, size, res == 0);
+
+    view->num_bundles  = tab.num_bundles;
+    view->num_messages = tab.num_messages;
+    view->num_args     = tab.num_args;
+
+    return res;
+}
+
+// ============================================================================
+
+static void osc_parse_result_clear (OscParseResult* result) {
+    memset(result, 0, sizeof(*result));
+    result->error = OSC_ERR_NONE;
+    result->arg   = -1;
+}
+
+static int osc_validate_tables (const uint8_t* data, size_t size, int mode, int quiet,
+                                OscInfo* info, OscParseResult* result) {
+
+    OscTables tab;
+    memset(&tab, 0, sizeof(tab));
+    tab.max_bundles  = SIZE_MAX;
+    tab.max_messages = SIZE_MAX;
+    tab.max_args     = SIZE_MAX;
+    tab.check        = 1;
+    tab.mode         = mode;
+    tab.quiet        = quiet;
+    tab.result       = result;
+
+    if (result) {
+        osc_parse_result_clear(result);
+    }
+
+    int res = osc_parse_flat(data, size, &tab);
+
+    if (info) {
+        // A bare message is not wrapped in an implicit bundle here
+        info->num_bundles  = tab.max_depth ? tab.num_bundles : 0;
+        info->num_messages = tab.num_messages;
+        info->num_args     = tab.num_args;
+        info->depth        = tab.max_depth;
+        info->addr         = tab.addr;
+    }
+
+    return res;
+}
+
+int osc_validate (const uint8_t* data, size_t size, OscInfo* info) {
+    return osc_validate_tables(data, size, OSC_PARSE_LENIENT, 0, info, NULL);
+}
+
+int osc_validate_result (const uint8_t* data, size_t size, int mode,
+                         OscInfo* info, OscParseResult* result) {
+    return osc_validate_tables(data, size, mode, 0, info, result);
+}
+
+// Moves the blob payloads of a parsed message behind its arguments, in the
+// same allocation, so that they outlive the source buffer
+static void osc_parse_copy_blobs (OscArena* arena, OscMessage* msg) {
+
+    size_t bytes = 0;
+    int    blobs = 0;
+    for (size_t i=0; i<msg->num_args; ++i) {
+        if (msg->tags[i] == 'b') {
+            bytes += (size_t)msg->args[i].blob.size;
+            blobs  = 1;
+        }
+    }
+
+    if (!blobs) {
+        return;
+    }
+
+    size_t       asize = msg->num_args * sizeof(OscArgument);
+    OscArgument* args  = (OscArgument*)(arena ? osc_arena_alloc(arena, asize + bytes) :
+                                                osc_pool_alloc(asize + bytes));
+    memcpy((void*)args, msg->args, asize);
+
+    uint8_t* dst = (uint8_t*)&args[msg->num_args];
+    for (size_t i=0; i<msg->num_args; ++i) {
+        if (msg->tags[i] == 'b') {
+            memcpy(dst, args[i].blob.data, (size_t)args[i].blob.size);
+            args[i].blob.data = dst;
+            dst += args[i].blob.size;
+        }
+    }
+
+    if (!arena) osc_pool_free((void*)msg->args);
+    msg->args = args;
+}
+
+static void osc_parse_copy_bundle (OscArena* arena, OscBundle* bundle) {
+
+    for (OscMessage* msg = bundle->messages; msg; msg = msg->next) {
+        osc_parse_copy_blobs(arena, msg);
+    }
+
+    for (OscBundle* bun = bundle->bundles; bun; bun = bun->next) {
+        osc_parse_copy_bundle(arena, bun);
+    }
+}
+
+OscBundle* osc_parse_result (OscArena* arena, const uint8_t* data, size_t size,
+                             int mode, OscParseResult* result) {
+
+    OscBundle* bundle = NULL;
+
+    if (mode & OSC_PARSE_STRICT) {
+        if (osc_validate_tables(data, size, mode, 0, NULL, result)) {
+            return NULL;
+        }
+        bundle = osc_parse_ex(arena, data, size);
+    }
+    else {
+        if (result) {
+            osc_parse_result_clear(result);
+        }
+
+        bundle = osc_parse_ex(arena, data, size);
+
+        // Locate the fault, already counted by the parser
+        if (!bundle && result) {
+            osc_validate_tables(data, size, mode, 1, NULL, result);
+        }
+    }
+
+    if (bundle && (mode & OSC_PARSE_COPY_BLOBS)) {
+        osc_parse_copy_bundle(arena, bundle);
+    }
+
+    return bundle;
+}
+
+// ============================================================================
+
+// Rounds up to pointer / 64-bit alignment
+#define OSC_PACKET_ALIGN(x) (((x) + 7) & ~(size_t)7)
+
+static OscPacket* osc_parse_packet_flat (const uint8_t* data, size_t size) {
+
+    // Count pass
+    OscTables tab;
+    memset(&tab, 0, sizeof(tab));
+    tab.max_bundles  = SIZE_MAX;
+    tab.max_messages = SIZE_MAX;
+    tab.max_args     = SIZE_MAX;
+
+    if (osc_parse_flat(data, size, &tab)) {
+        return NULL;
+    }
+
+    // Single allocation: header, tables, then a copy of the data the
+    // strings point into
+    size_t ofs_bundles  = OSC_PACKET_ALIGN(sizeof(OscPacket));
+    size_t ofs_messages = ofs_bundles  + OSC_PACKET_ALIGN(tab.num_bundles  * sizeof(OscBundleView));
+    size_t ofs_args     = ofs_messages + OSC_PACKET_ALIGN(tab.num_messages * sizeof(OscMessageView));
+    size_t ofs_data     = ofs_args     + OSC_PACKET_ALIGN(tab.num_args     * sizeof(OscArgument));
+
+    uint8_t* mem = (uint8_t*)osc_malloc(ofs_data + size);
+    if (!mem) {
+        return NULL;
+    }
+
+    OSC_STAT_ALLOC(ofs_data + size);
+
+    uint8_t* copy = &mem[ofs_data];
+    memcpy(copy, data, size);
+
+    tab.bundles      = (OscBundleView*)&mem[ofs_bundles];
+    tab.messages     = (OscMessageView*)&mem[ofs_messages];
+    tab.args         = (OscArgument*)&mem[ofs_args];
+    tab.max_bundles  = tab.num_bundles;
+    tab.max_messages = tab.num_messages;
+    tab.max_args     = tab.num_args;
+
+    // Fill pass
+    if (osc_parse_flat(copy, size, &tab)) {
+        osc_free((void*)mem);
+        return NULL;
+    }
+
+    OscPacket* packet = (OscPacket*)mem;
+    packet->num_bundles  = tab.num_bundles;
+    packet->num_messages = tab.num_messages;
+    packet->num_args     = tab.num_args;
+    packet->bundles      = tab.bundles;
+    packet->messages     = tab.messages;
+    packet->args         = tab.args;
+
+    return packet;
+}
+
+OscPacket* osc_parse_packet (const uint8_t* data, size_t size) {
+
+    OSC_STAT_START(start);
+
+    OscPacket* packet = osc_parse_packet_flat(data, size);
+
+    OSC_STAT_PARSED(start, size, packet != NULL);
+    return packet;
+}
+
+OscPacket* osc_packet_delete (const OscPacket* packet) {
+
+    if (packet) {
+        osc_free((void*)packet);
+    }
+
+    return NULL;
+}
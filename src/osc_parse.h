@@ -0,0 +1,17 @@
+#ifndef OSC_PARSE_H
+#define OSC_PARSE_H
+
+#include "osc.h"
+
+// ============================================================================
+// Internal: entry points of the tree parser used by the parallel parser
+
+// Parses one element of a bundle at nesting depth (2 for the elements of
+// the outer bundle) into *pmsg or *pbundle. pelements counts the nested
+// elements. Returns -1 on error.
+int osc_parse_element (const uint8_t* data, size_t size, size_t depth, size_t* pelements,
+                       OscMessage** pmsg, OscBundle** pbundle);
+
+// ============================================================================
+
+#endif // OSC_PARSE_H
@@ -0,0 +1,120 @@
+#include "osc_plan.h"
+
+#include <string.h>
+
+// ============================================================================
+
+// Per-thread plan cache, direct mapped
+static __thread OscPlan osc_plan_cache [OSC_PLAN_CACHE_SIZE];
+
+// ============================================================================
+
+void osc_plan_compile (OscPlan* plan, const char* tags, size_t num_args) {
+
+    memcpy(plan->tags, tags, num_args);
+    plan->tags[num_args] = 0;
+
+    plan->num_args = num_args;
+    plan->valid    = 0;
+    plan->fixed    = 1;
+    plan->size     = 0;
+
+    int depth = 0;
+
+    for (size_t i=0; i<num_args; ++i) {
+        OscPlanStep* step = &plan->steps[i];
+
+        step->width  = 0;
+        step->offset = (uint16_t)plan->size;
+
+        switch (tags[i]) {
+
+            case 'i':
+            case 'f':
+            case 'r':
+            case 'm':
+                step->kind  = OSC_KIND_32;
+                step->width = 4;
+                break;
+
+            case 'h':
+            case 'd':
+            case 't':
+                step->kind  = OSC_KIND_64;
+                step->width = 8;
+                break;
+
+            case 'c':
+                step->kind  = OSC_KIND_CHAR;
+                step->width = 4;
+                break;
+
+            case 'T':
+                step->kind = OSC_KIND_TRUE;
+                break;
+
+            case 'F':
+            case 'N':
+                step->kind = OSC_KIND_ZERO;
+                break;
+
+            case 'I':
+                step->kind = OSC_KIND_INF;
+                break;
+
+            // Arrays
+            case '[':
+                step->kind = OSC_KIND_ZERO;
+                depth++;
+                break;
+
+            case ']':
+                step->kind = OSC_KIND_ZERO;
+                if (--depth < 0) return;
+                break;
+
+            case 's':
+            case 'S':
+                step->kind  = OSC_KIND_STRING;
+                plan->fixed = 0;
+                break;
+
+            case 'b':
+                step->kind  = OSC_KIND_BLOB;
+                plan->fixed = 0;
+                break;
+
+            // Unknown
+            default:
+                return;
+        }
+
+        plan->size += step->width;
+    }
+
+    plan->valid = (depth == 0);
+}
+
+const OscPlan* osc_plan_get (const char* tags, size_t num_args) {
+
+    if (num_args > OSC_PLAN_MAX_TAGS) {
+        return NULL;
+    }
+
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (size_t i=0; i<num_args; ++i) {
+        hash = (hash ^ (uint8_t)tags[i]) * 16777619u;
+    }
+
+    OscPlan* plan = &osc_plan_cache[hash & (OSC_PLAN_CACHE_SIZE - 1)];
+
+    // Miss, (re)compile. Slots start zeroed which is an empty tag string.
+    if (plan->num_args != num_args || memcmp(plan->tags, tags, num_args) ||
+        (num_args == 0 && !plan->valid))
+    {
+        osc_plan_compile(plan, tags, num_args);
+    }
+
+    return plan;
+}
@@ -0,0 +1,61 @@
+#ifndef OSC_PLAN_H
+#define OSC_PLAN_H
+
+#include "osc.h"
+
+// ============================================================================
+// Internal: precompiled argument layouts ("plans") of tag strings
+
+// Longest tag string that gets a plan
+#ifndef OSC_PLAN_MAX_TAGS
+#define OSC_PLAN_MAX_TAGS   32
+#endif
+
+// Plan cache size (per thread), power of 2
+#ifndef OSC_PLAN_CACHE_SIZE
+#define OSC_PLAN_CACHE_SIZE 64
+#endif
+
+// Argument kinds
+#define OSC_KIND_ZERO       0   // No data, value 0 (F, N, [, ])
+#define OSC_KIND_TRUE       1   // No data, value 1 (T)
+#define OSC_KIND_INF        2   // No data, infinity (I)
+#define OSC_KIND_32         3   // Big-endian 32-bit (i, f, r, m)
+#define OSC_KIND_64         4   // Big-endian 64-bit (h, d, t)
+#define OSC_KIND_CHAR       5   // char as 32-bit (c)
+#define OSC_KIND_STRING     6   // Padded string (s, S)
+#define OSC_KIND_BLOB       7   // Size prefixed padded blob (b)
+
+// Plan step, one per tag
+typedef struct _OscPlanStep {
+
+    uint8_t     kind;   // Argument kind
+    uint8_t     width;  // Data size, 0 for variable
+    uint16_t    offset; // Offset from the first argument (fixed plans only)
+
+} OscPlanStep;
+
+// Tag string plan
+typedef struct _OscPlan {
+
+    char        tags [OSC_PLAN_MAX_TAGS + 1];
+    size_t      num_args;
+
+    int         valid;  // Known tags with balanced arrays
+    int         fixed;  // No variable width arguments, offsets are valid
+    size_t      size;   // Argument data size (fixed plans only)
+
+    OscPlanStep steps [OSC_PLAN_MAX_TAGS];
+
+} OscPlan;
+
+// Compiles a plan for a tag string of at most OSC_PLAN_MAX_TAGS
+void osc_plan_compile (OscPlan* plan, const char* tags, size_t num_args);
+
+// Returns the cached plan of the tag string or NULL if it is too long. The
+// plan is valid until the next call from the same thread.
+const OscPlan* osc_plan_get (const char* tags, size_t num_args);
+
+// ============================================================================
+
+#endif // OSC_PLAN_H
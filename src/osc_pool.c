@@ -0,0 +1,150 @@
+#include "osc_pool.h"
+#include "osc_stats.h"
+
+#include <string.h>
+
+// ============================================================================
+
+// Fixed block size pools in a single slab, one region per size class
+struct _OscPool {
+
+    uint8_t*    regions [OSC_POOL_CLASSES + 1]; // Region bounds, slab first
+    void*       free    [OSC_POOL_CLASSES];     // Free lists (next pointer in the block)
+
+    size_t      used;   // Blocks handed out
+    size_t      misses; // Allocations passed to osc_malloc()
+};
+
+// Pool bound to the calling thread
+static __thread OscPool* osc_pool_current = NULL;
+
+// ============================================================================
+
+OscPool* osc_pool_create (const size_t counts[OSC_POOL_CLASSES]) {
+
+    size_t size = 0;
+    for (size_t c=0; c<OSC_POOL_CLASSES; ++c) {
+        size += counts[c] * ((size_t)OSC_POOL_MIN_SIZE << c);
+    }
+
+    OscPool* pool = (OscPool*)osc_malloc(sizeof(OscPool));
+    if (!pool) {
+        return NULL;
+    }
+
+    uint8_t* slab = (uint8_t*)osc_malloc(size ? size : 1);
+    if (!slab) {
+        osc_free((void*)pool);
+        return NULL;
+    }
+
+    // Thread the free lists through the blocks
+    uint8_t* ptr = slab;
+    for (size_t c=0; c<OSC_POOL_CLASSES; ++c) {
+        size_t block = (size_t)OSC_POOL_MIN_SIZE << c;
+
+        pool->regions[c] = ptr;
+        pool->free[c]    = NULL;
+
+        for (size_t i=counts[c]; i-- > 0; ) {
+            void** p = (void**)&ptr[i * block];
+            *p = pool->free[c];
+            pool->free[c] = (void*)p;
+        }
+
+        ptr += counts[c] * block;
+    }
+
+    pool->regions[OSC_POOL_CLASSES] = ptr;
+    pool->used   = 0;
+    pool->misses = 0;
+
+    return pool;
+}
+
+OscPool* osc_pool_delete (OscPool* pool) {
+
+    if (!pool) {
+        return NULL;
+    }
+
+    if (osc_pool_current == pool) {
+        osc_pool_current = NULL;
+    }
+
+    osc_free((void*)pool->regions[0]);
+    osc_free((void*)pool);
+
+    return NULL;
+}
+
+OscPool* osc_pool_bind (OscPool* pool) {
+
+    OscPool* prev = osc_pool_current;
+    osc_pool_current = pool;
+
+    return prev;
+}
+
+size_t osc_pool_used (const OscPool* pool) {
+    return pool->used;
+}
+
+size_t osc_pool_misses (const OscPool* pool) {
+    return pool->misses;
+}
+
+// ============================================================================
+
+void* osc_pool_alloc (size_t size) {
+
+    OscPool* pool = osc_pool_current;
+    if (!pool) {
+        OSC_STAT_ALLOC(size);
+        return osc_malloc(size);
+    }
+
+    // Smallest class that fits and has a free block
+    size_t c = 0;
+    while (c < OSC_POOL_CLASSES && ((size_t)OSC_POOL_MIN_SIZE << c) < size) c++;
+
+    for (; c < OSC_POOL_CLASSES; ++c) {
+        void** p = (void**)pool->free[c];
+        if (p) {
+            pool->free[c] = *p;
+            pool->used++;
+            return (void*)p;
+        }
+    }
+
+    pool->misses++;
+
+    OSC_STAT_ALLOC(size);
+    return osc_malloc(size);
+}
+
+void osc_pool_free (void* ptr) {
+
+    OscPool* pool = osc_pool_current;
+    uint8_t* p    = (uint8_t*)ptr;
+
+    if (!pool || p < pool->regions[0] || p >= pool->regions[OSC_POOL_CLASSES]) {
+        osc_free(ptr);
+        return;
+    }
+
+    size_t c = 0;
+    while (p >= pool->regions[c + 1]) c++;
+
+    *(void**)p = pool->free[c];
+    pool->free[c] = ptr;
+    pool->used--;
+}
+
+char* osc_pool_strdup (OscArena* arena, const char* str) {
+    size_t len = strlen(str);
+    char*  res = (char*)(arena ? osc_arena_alloc(arena, len + 1) : osc_pool_alloc(len + 1));
+
+    memcpy(res, str, len + 1);
+    return res;
+}
@@ -0,0 +1,20 @@
+#ifndef OSC_POOL_H
+#define OSC_POOL_H
+
+#include "osc.h"
+
+// ============================================================================
+// Internal: allocation of message / bundle objects and strings. Served by
+// the pool bound to the calling thread when there is one, osc_malloc() /
+// osc_free() otherwise.
+
+void* osc_pool_alloc (size_t size);
+void  osc_pool_free  (void* ptr);
+
+// String owned by an object the library deletes, from the arena when given.
+// Public osc_strdup() stays on osc_malloc() as callers may osc_free() it.
+char* osc_pool_strdup (OscArena* arena, const char* str);
+
+// ============================================================================
+
+#endif // OSC_POOL_H
@@ -0,0 +1,203 @@
+#include "osc.h"
+
+#include <string.h>
+
+// ============================================================================
+
+// Keeps producer and consumer indices on separate cache lines
+#define OSC_QUEUE_PAD   64
+
+typedef struct _OscQueueCell {
+
+    size_t  seq;    // Sequence number (MPSC only)
+    void*   item;
+
+} OscQueueCell;
+
+struct _OscQueue {
+
+    int             mode;
+    size_t          mask;       // Capacity - 1
+    OscQueueCell*   cells;
+
+    uint8_t         pad0 [OSC_QUEUE_PAD];
+
+    size_t          head;       // Consumer index
+    size_t          tail_cache; // Consumer copy of tail (SPSC)
+
+    uint8_t         pad1 [OSC_QUEUE_PAD];
+
+    size_t          tail;       // Producer index
+    size_t          head_cache; // Producer copy of head (SPSC)
+
+    uint8_t         pad2 [OSC_QUEUE_PAD];
+};
+
+// ============================================================================
+
+OscQueue* osc_queue_create (int mode, size_t capacity) {
+
+    if ((mode != OSC_QUEUE_SPSC && mode != OSC_QUEUE_MPSC) || capacity == 0 ||
+        capacity > (SIZE_MAX >> 2) / sizeof(OscQueueCell)) {
+        return NULL;
+    }
+
+    // Round up to a power of 2
+    size_t size = 1;
+    while (size < capacity) size <<= 1;
+
+    OscQueue* queue = (OscQueue*)osc_malloc(sizeof(OscQueue));
+    if (!queue) {
+        return NULL;
+    }
+
+    memset((void*)queue, 0, sizeof(OscQueue));
+    queue->mode = mode;
+    queue->mask = size - 1;
+
+    queue->cells = (OscQueueCell*)osc_malloc(size * sizeof(OscQueueCell));
+    if (!queue->cells) {
+        return osc_queue_delete(queue);
+    }
+
+    for (size_t i=0; i<size; ++i) {
+        queue->cells[i].seq  = i;
+        queue->cells[i].item = NULL;
+    }
+
+    return queue;
+}
+
+OscQueue* osc_queue_delete (OscQueue* queue) {
+
+    if (!queue) {
+        return NULL;
+    }
+
+    if (queue->cells) osc_free((void*)queue->cells);
+    osc_free((void*)queue);
+
+    return NULL;
+}
+
+// ============================================================================
+
+static int osc_queue_push_spsc (OscQueue* queue, void* item) {
+
+    size_t tail = queue->tail;
+
+    // Refresh the consumer index only when the ring looks full
+    if (tail - queue->head_cache > queue->mask) {
+        queue->head_cache = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+        if (tail - queue->head_cache > queue->mask) {
+            return -1;
+        }
+    }
+
+    queue->cells[tail & queue->mask].item = item;
+    __atomic_store_n(&queue->tail, tail + 1, __ATOMIC_RELEASE);
+
+    return 0;
+}
+
+static void* osc_queue_pop_spsc (OscQueue* queue) {
+
+    size_t head = queue->head;
+
+    if (head == queue->tail_cache) {
+        queue->tail_cache = __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+        if (head == queue->tail_cache) {
+            return NULL;
+        }
+    }
+
+    void* item = queue->cells[head & queue->mask].item;
+    __atomic_store_n(&queue->head, head + 1, __ATOMIC_RELEASE);
+
+    return item;
+}
+
+// Producers claim cells by sequence number (bounded MPMC ring by D. Vyukov)
+static int osc_queue_push_mpsc (OscQueue* queue, void* item) {
+
+    size_t        pos = __atomic_load_n(&queue->tail, __ATOMIC_RELAXED);
+    OscQueueCell* cell;
+
+    for (;;) {
+        cell = &queue->cells[pos & queue->mask];
+
+        size_t   seq = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+        intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+
+        if (dif == 0) {
+            if (__atomic_compare_exchange_n(&queue->tail, &pos, pos + 1, 1,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        }
+        else if (dif < 0) {
+            return -1;
+        }
+        else {
+            pos = __atomic_load_n(&queue->tail, __ATOMIC_RELAXED);
+        }
+    }
+
+    cell->item = item;
+    __atomic_store_n(&cell->seq, pos + 1, __ATOMIC_RELEASE);
+
+    return 0;
+}
+
+static void* osc_queue_pop_mpsc (OscQueue* queue) {
+
+    size_t        pos  = queue->head;
+    OscQueueCell* cell = &queue->cells[pos & queue->mask];
+
+    size_t seq = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+    if (seq != pos + 1) {
+        return NULL;
+    }
+
+    void* item = cell->item;
+    queue->head = pos + 1;
+
+    // Hand the cell back to producers for the next lap
+    __atomic_store_n(&cell->seq, pos + queue->mask + 1, __ATOMIC_RELEASE);
+
+    return item;
+}
+
+// ============================================================================
+
+int osc_queue_push (OscQueue* queue, void* item) {
+
+    if (!item) {
+        return -1;
+    }
+
+    return queue->mode == OSC_QUEUE_SPSC ?
+        osc_queue_push_spsc(queue, item) :
+        osc_queue_push_mpsc(queue, item);
+}
+
+void* osc_queue_pop (OscQueue* queue) {
+
+    return queue->mode == OSC_QUEUE_SPSC ?
+        osc_queue_pop_spsc(queue) :
+        osc_queue_pop_mpsc(queue);
+}
+
+size_t osc_queue_drain (OscQueue* queue, void (*release) (void* item)) {
+
+    size_t count = 0;
+    for (void* item; (item = osc_queue_pop(queue)); ++count) {
+        release(item);
+    }
+
+    return count;
+}
+
+size_t osc_queue_capacity (const OscQueue* queue) {
+    return queue->mask + 1;
+}
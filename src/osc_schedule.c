@@ -0,0 +1,402 @@
+#include "osc.h"
+
+#include <string.h>
+#include <time.h>
+
+// ============================================================================
+
+// Wheel resolution, 2^-12 s (~244 us) in NTP units
+#define OSC_WHEEL_SHIFT     20
+
+// Wheel geometry, 4 levels of 256 slots cover 2^32 ticks (~12 days)
+#define OSC_WHEEL_LEVELS    4
+#define OSC_WHEEL_BITS      8
+#define OSC_WHEEL_SLOTS     (1 << OSC_WHEEL_BITS)
+#define OSC_WHEEL_MASK      (OSC_WHEEL_SLOTS - 1)
+
+// Seconds between the NTP (1900) and the Unix (1970) epoch
+#define OSC_NTP_UNIX_OFFSET 2208988800ULL
+
+// Pending bundle
+typedef struct _OscTimer {
+
+    uint64_t                time;   // Release time (NTP)
+    const OscBundle*        bundle; // Bundle whose messages to release
+
+    struct _OscTimer*       owner;  // Timer of the root bundle
+    size_t                  refs;   // Pending timers of the tree (owner only)
+
+    struct _OscTimer*       next;
+
+} OscTimer;
+
+// Scheduler
+struct _OscScheduler {
+
+    OscMethod   method;
+    void*       user;
+
+    uint64_t    tick;       // Current tick, earlier ones are processed
+    size_t      pending;    // Pending timers
+
+    OscTimer*   due;        // Timers already due when added
+    OscTimer*   wheel [OSC_WHEEL_LEVELS][OSC_WHEEL_SLOTS];
+    size_t      count [OSC_WHEEL_LEVELS];
+
+    OscTimer*   pool;       // Free timers
+};
+
+// ============================================================================
+
+int64_t osc_time_now (void) {
+
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+
+    uint64_t sec  = (uint64_t)ts.tv_sec + OSC_NTP_UNIX_OFFSET;
+    uint64_t frac = ((uint64_t)ts.tv_nsec << 32) / 1000000000ULL;
+
+    return (int64_t)((sec << 32) | frac);
+}
+
+// ============================================================================
+
+static OscTimer* osc_timer_alloc (OscScheduler* sched) {
+
+    OscTimer* timer = sched->pool;
+    if (timer) {
+        sched->pool = timer->next;
+    }
+    else {
+        timer = (OscTimer*)osc_malloc(sizeof(OscTimer));
+    }
+
+    return timer;
+}
+
+static void osc_timer_release (OscScheduler* sched, OscTimer* timer) {
+    timer->next = sched->pool;
+    sched->pool = timer;
+}
+
+// Links the timer after those due no later, lists that fire stay sorted
+static void osc_timer_link_sorted (OscTimer** plist, OscTimer* timer) {
+
+    while (*plist && (*plist)->time <= timer->time) {
+        plist = &(*plist)->next;
+    }
+
+    timer->next = *plist;
+    *plist      = timer;
+}
+
+static void osc_timer_insert (OscScheduler* sched, OscTimer* timer) {
+
+    uint64_t tick = timer->time >> OSC_WHEEL_SHIFT;
+
+    // Already passed
+    if (tick < sched->tick) {
+        osc_timer_link_sorted(&sched->due, timer);
+        return;
+    }
+
+    // Pick the level by distance, clamp far ones to the top level. They
+    // get re-inserted by cascading until they come within range.
+    uint64_t diff  = tick - sched->tick;
+    size_t   level = 0;
+
+    while (level < OSC_WHEEL_LEVELS - 1 &&
+           (diff >> (OSC_WHEEL_BITS * (level + 1))) != 0)
+    {
+        level++;
+    }
+
+    uint64_t range = 1ULL << (OSC_WHEEL_BITS * OSC_WHEEL_LEVELS);
+    if (diff >= range) {
+        tick = sched->tick + range - 1;
+    }
+
+    size_t slot = (tick >> (OSC_WHEEL_BITS * level)) & OSC_WHEEL_MASK;
+
+    // Only the lowest level fires, the others are re-inserted
+    if (level == 0) {
+        osc_timer_link_sorted(&sched->wheel[0][slot], timer);
+    }
+    else {
+        timer->next = sched->wheel[level][slot];
+        sched->wheel[level][slot] = timer;
+    }
+
+    sched->count[level]++;
+}
+
+// Moves timers of the slot at the current tick of each wrapped level down
+static void osc_timer_cascade (OscScheduler* sched) {
+
+    for (size_t level = 1; level < OSC_WHEEL_LEVELS; ++level) {
+
+        // Lower level did not wrap
+        if (sched->tick & ((1ULL << (OSC_WHEEL_BITS * level)) - 1)) {
+            break;
+        }
+
+        size_t    slot = (sched->tick >> (OSC_WHEEL_BITS * level)) & OSC_WHEEL_MASK;
+        OscTimer* list = sched->wheel[level][slot];
+
+        sched->wheel[level][slot] = NULL;
+
+        while (list) {
+            OscTimer* next = list->next;
+            sched->count[level]--;
+            osc_timer_insert(sched, list);
+            list = next;
+        }
+    }
+}
+
+// Releases messages of the timer and frees it. Frees the bundle tree once
+// all of its timers are done.
+static size_t osc_timer_fire (OscScheduler* sched, OscTimer* timer) {
+
+    size_t count = 0;
+
+    for (const OscMessage* msg = timer->bundle->messages; msg; msg = msg->next) {
+        sched->method(msg, (int64_t)timer->time, sched->user);
+        count++;
+    }
+
+    sched->pending--;
+
+    OscTimer* owner = timer->owner;
+    if (timer != owner) {
+        osc_timer_release(sched, timer);
+    }
+
+    if (--owner->refs == 0) {
+        osc_bundle_delete(owner->bundle);
+        osc_timer_release(sched, owner);
+    }
+
+    return count;
+}
+
+// Fires timers of a sorted list that are due, returns the rest in order.
+// The list must be detached, the method may add timers.
+static OscTimer* osc_timer_fire_list (OscScheduler* sched, OscTimer* list,
+                                      uint64_t now, size_t* pcount, size_t* pfired) {
+
+    OscTimer*  keep  = NULL;
+    OscTimer** ptail = &keep;
+
+    while (list) {
+        OscTimer* next = list->next;
+
+        if (list->time <= now) {
+            *pcount += osc_timer_fire(sched, list);
+            (*pfired)++;
+        }
+        else {
+            *ptail = list;
+            ptail  = &list->next;
+        }
+
+        list = next;
+    }
+
+    *ptail = NULL;
+    return keep;
+}
+
+// Merges the timers added while a list was fired into what remains of it,
+// both sorted. Remaining timers go first on equal times.
+static OscTimer* osc_timer_merge (OscTimer* list, OscTimer* added) {
+
+    OscTimer*  head  = NULL;
+    OscTimer** ptail = &head;
+
+    while (list && added) {
+        OscTimer** pmin = added->time < list->time ? &added : &list;
+        *ptail = *pmin;
+        ptail  = &(*pmin)->next;
+        *pmin  = (*pmin)->next;
+    }
+
+    *ptail = list ? list : added;
+    return head;
+}
+
+// ============================================================================
+
+OscScheduler* osc_scheduler_create (OscMethod method, void* user, int64_t now) {
+
+    if (!method) {
+        return NULL;
+    }
+
+    OscScheduler* sched = (OscScheduler*)osc_malloc(sizeof(OscScheduler));
+    memset((void*)sched, 0, sizeof(OscScheduler));
+
+    sched->method = method;
+    sched->user   = user;
+    sched->tick   = (uint64_t)now >> OSC_WHEEL_SHIFT;
+
+    return sched;
+}
+
+static void osc_timer_free_list (OscTimer* list) {
+
+    while (list) {
+        OscTimer* next  = list->next;
+        OscTimer* owner = list->owner;
+
+        if (list != owner) {
+            osc_free((void*)list);
+        }
+
+        if (--owner->refs == 0) {
+            osc_bundle_delete(owner->bundle);
+            osc_free((void*)owner);
+        }
+
+        list = next;
+    }
+}
+
+OscScheduler* osc_scheduler_delete (OscScheduler* sched) {
+
+    if (!sched) {
+        return NULL;
+    }
+
+    // Pending timers and their bundles
+    osc_timer_free_list(sched->due);
+    for (size_t level = 0; level < OSC_WHEEL_LEVELS; ++level) {
+        for (size_t slot = 0; slot < OSC_WHEEL_SLOTS; ++slot) {
+            osc_timer_free_list(sched->wheel[level][slot]);
+        }
+    }
+
+    // Free timers
+    for (OscTimer* curr = sched->pool; curr;) {
+        OscTimer* next = curr->next;
+        osc_free((void*)curr);
+        curr = next;
+    }
+
+    osc_free((void*)sched);
+
+    return NULL;
+}
+
+// ============================================================================
+
+static void osc_scheduler_add_tree (OscScheduler* sched, const OscBundle* bundle,
+                                    uint64_t time, OscTimer* owner) {
+
+    for (const OscBundle* bun = bundle->bundles; bun; bun = bun->next) {
+
+        // Sub-bundles cannot be released before the enclosing one
+        uint64_t sub = (uint64_t)bun->timestamp;
+        if (sub < time) sub = time;
+
+        OscTimer* timer = osc_timer_alloc(sched);
+        timer->time   = sub;
+        timer->bundle = bun;
+        timer->owner  = owner;
+        timer->refs   = 0;
+
+        owner->refs++;
+        sched->pending++;
+
+        osc_timer_insert(sched, timer);
+        osc_scheduler_add_tree(sched, bun, sub, owner);
+    }
+}
+
+int osc_scheduler_add (OscScheduler* sched, OscBundle* bundle) {
+
+    if (!bundle) {
+        return -1;
+    }
+
+    OscTimer* owner = osc_timer_alloc(sched);
+    owner->time   = (uint64_t)bundle->timestamp;
+    owner->bundle = bundle;
+    owner->owner  = owner;
+    owner->refs   = 1;
+
+    sched->pending++;
+
+    // Enclosing bundle first, it precedes sub-bundles due at the same time
+    osc_timer_insert(sched, owner);
+    osc_scheduler_add_tree(sched, bundle, owner->time, owner);
+
+    return 0;
+}
+
+size_t osc_scheduler_run (OscScheduler* sched, int64_t now) {
+
+    uint64_t now_tick = (uint64_t)now >> OSC_WHEEL_SHIFT;
+    size_t   count    = 0;
+
+    // Late arrivals
+    OscTimer* due   = sched->due;
+    size_t    fired = 0;
+
+    sched->due = NULL;
+    due = osc_timer_fire_list(sched, due, (uint64_t)now, &count, &fired);
+    sched->due = osc_timer_merge(due, sched->due);
+
+    while (1) {
+
+        // Current slot. Timers may remain in it when it is the last tick.
+        size_t    slot = sched->tick & OSC_WHEEL_MASK;
+        OscTimer* list = sched->wheel[0][slot];
+
+        if (list) {
+            sched->wheel[0][slot] = NULL;
+            fired = 0;
+
+            list = osc_timer_fire_list(sched, list, (uint64_t)now, &count, &fired);
+
+            sched->wheel[0][slot] = osc_timer_merge(list, sched->wheel[0][slot]);
+            sched->count[0] -= fired;
+        }
+
+        if (sched->tick >= now_tick) {
+            break;
+        }
+
+        // Find the lowest populated level and skip to its next boundary
+        size_t level = 0;
+        while (level < OSC_WHEEL_LEVELS && sched->count[level] == 0) {
+            level++;
+        }
+
+        if (level == OSC_WHEEL_LEVELS) {
+            sched->tick = now_tick;
+            break;
+        }
+
+        uint64_t next = sched->tick + 1;
+        if (level > 0) {
+            uint64_t span = 1ULL << (OSC_WHEEL_BITS * level);
+            next = (sched->tick | (span - 1)) + 1;
+        }
+
+        // No boundary of a populated level crossed
+        if (next > now_tick) {
+            sched->tick = now_tick;
+            continue;
+        }
+
+        sched->tick = next;
+        osc_timer_cascade(sched);
+    }
+
+    return count;
+}
+
+size_t osc_scheduler_pending (const OscScheduler* sched) {
+    return sched->pending;
+}
@@ -0,0 +1,256 @@
+#include "osc_simd.h"
+
+#include <pthread.h>
+#include <string.h>
+
+#ifdef OSC_SIMD_X86
+#include <immintrin.h>
+#endif
+
+// ============================================================================
+
+static pthread_once_t osc_simd_once = PTHREAD_ONCE_INIT;
+
+static int osc_simd_max = OSC_SIMD_SCALAR;  // Detected level, set once
+static int osc_simd_cur = OSC_SIMD_SCALAR;  // Selected level, atomic
+
+static void osc_simd_detect (void) {
+
+    int level = OSC_SIMD_SCALAR;
+
+#ifdef OSC_SIMD_X86
+    __builtin_cpu_init();
+
+    level = OSC_SIMD_SSE2;
+    if (__builtin_cpu_supports("avx2")) {
+        level = OSC_SIMD_AVX2;
+    }
+#endif
+
+    osc_simd_max = level;
+    __atomic_store_n(&osc_simd_cur, level, __ATOMIC_RELAXED);
+}
+
+int osc_simd_level (void) {
+    pthread_once(&osc_simd_once, osc_simd_detect);
+    return __atomic_load_n(&osc_simd_cur, __ATOMIC_RELAXED);
+}
+
+void osc_simd_set_level (int level) {
+
+    pthread_once(&osc_simd_once, osc_simd_detect);
+
+    if (level < OSC_SIMD_SCALAR) level = OSC_SIMD_SCALAR;
+    if (level > osc_simd_max)    level = osc_simd_max;
+
+    __atomic_store_n(&osc_simd_cur, level, __ATOMIC_RELAXED);
+}
+
+// ============================================================================
+// Scalar
+
+static size_t osc_scan_scalar (const uint8_t* data, size_t size, size_t ptr) {
+
+    for (; ptr < size; ++ptr) {
+        if (data[ptr] == 0) {
+            return ptr + 1;
+        }
+    }
+
+    return 0;
+}
+
+static void osc_load32_scalar (OscArgument* args, const uint8_t* src, size_t count) {
+
+    for (size_t i=0; i<count; ++i, src += 4) {
+        memset(&args[i], 0, sizeof(OscArgument));
+        args[i].i32 = (int32_t)(((uint32_t)src[0] << 24) | ((uint32_t)src[1] << 16) |
+                                ((uint32_t)src[2] <<  8) |  (uint32_t)src[3]);
+    }
+}
+
+static void osc_load64_scalar (OscArgument* args, const uint8_t* src, size_t count) {
+
+    for (size_t i=0; i<count; ++i, src += 8) {
+        uint64_t v = 0;
+        for (size_t j=0; j<8; ++j) {
+            v = (v << 8) | src[j];
+        }
+        memset(&args[i], 0, sizeof(OscArgument));
+        args[i].i64 = (int64_t)v;
+    }
+}
+
+#ifdef OSC_SIMD_X86
+
+// Vector stores write whole 16 byte arguments
+typedef char osc_simd_arg_size [sizeof(OscArgument) == 16 ? 1 : -1];
+
+// ============================================================================
+// SSE2 (x86-64 baseline, no byte shuffle)
+
+// Swaps the bytes of each 16-bit lane
+static inline __m128i osc_swap16_sse2 (__m128i v) {
+    return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+}
+
+static size_t osc_scan_sse2 (const uint8_t* data, size_t size, size_t ptr) {
+
+    const __m128i zero = _mm_setzero_si128();
+
+    for (; ptr + 16 <= size; ptr += 16) {
+        __m128i v    = _mm_loadu_si128((const __m128i*)&data[ptr]);
+        int     mask = _mm_movemask_epi8(_mm_cmpeq_epi8(v, zero));
+        if (mask) {
+            return ptr + (size_t)__builtin_ctz((unsigned)mask) + 1;
+        }
+    }
+
+    return osc_scan_scalar(data, size, ptr);
+}
+
+static void osc_load32_sse2 (OscArgument* args, const uint8_t* src, size_t count) {
+
+    const __m128i zero = _mm_setzero_si128();
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4, src += 16) {
+        __m128i v = osc_swap16_sse2(_mm_loadu_si128((const __m128i*)src));
+        v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+        v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+
+        // Widen each value to a whole argument
+        __m128i lo = _mm_unpacklo_epi32(v, zero);
+        __m128i hi = _mm_unpackhi_epi32(v, zero);
+
+        _mm_storeu_si128((__m128i*)&args[i + 0], _mm_unpacklo_epi64(lo, zero));
+        _mm_storeu_si128((__m128i*)&args[i + 1], _mm_unpackhi_epi64(lo, zero));
+        _mm_storeu_si128((__m128i*)&args[i + 2], _mm_unpacklo_epi64(hi, zero));
+        _mm_storeu_si128((__m128i*)&args[i + 3], _mm_unpackhi_epi64(hi, zero));
+    }
+
+    osc_load32_scalar(&args[i], src, count - i);
+}
+
+static void osc_load64_sse2 (OscArgument* args, const uint8_t* src, size_t count) {
+
+    const __m128i zero = _mm_setzero_si128();
+
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2, src += 16) {
+        __m128i v = osc_swap16_sse2(_mm_loadu_si128((const __m128i*)src));
+        v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+        v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+
+        _mm_storeu_si128((__m128i*)&args[i + 0], _mm_unpacklo_epi64(v, zero));
+        _mm_storeu_si128((__m128i*)&args[i + 1], _mm_unpackhi_epi64(v, zero));
+    }
+
+    osc_load64_scalar(&args[i], src, count - i);
+}
+
+// ============================================================================
+// AVX2
+
+__attribute__((target("avx2")))
+static size_t osc_scan_avx2 (const uint8_t* data, size_t size, size_t ptr) {
+
+    const __m256i zero = _mm256_setzero_si256();
+
+    for (; ptr + 32 <= size; ptr += 32) {
+        __m256i  v    = _mm256_loadu_si256((const __m256i*)&data[ptr]);
+        unsigned mask = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, zero));
+        if (mask) {
+            return ptr + (size_t)__builtin_ctz(mask) + 1;
+        }
+    }
+
+    return osc_scan_sse2(data, size, ptr);
+}
+
+__attribute__((target("avx2")))
+static void osc_load32_avx2 (OscArgument* args, const uint8_t* src, size_t count) {
+
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i swap = _mm256_setr_epi8(
+        3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+        3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8, src += 32) {
+        __m256i v = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)src), swap);
+
+        // Unpacking is per 128-bit lane, a = 0 | 4, b = 1 | 5, c = 2 | 6, d = 3 | 7
+        __m256i lo = _mm256_unpacklo_epi32(v, zero);
+        __m256i hi = _mm256_unpackhi_epi32(v, zero);
+        __m256i a  = _mm256_unpacklo_epi64(lo, zero);
+        __m256i b  = _mm256_unpackhi_epi64(lo, zero);
+        __m256i c  = _mm256_unpacklo_epi64(hi, zero);
+        __m256i d  = _mm256_unpackhi_epi64(hi, zero);
+
+        _mm256_storeu_si256((__m256i*)&args[i + 0], _mm256_permute2x128_si256(a, b, 0x20));
+        _mm256_storeu_si256((__m256i*)&args[i + 2], _mm256_permute2x128_si256(c, d, 0x20));
+        _mm256_storeu_si256((__m256i*)&args[i + 4], _mm256_permute2x128_si256(a, b, 0x31));
+        _mm256_storeu_si256((__m256i*)&args[i + 6], _mm256_permute2x128_si256(c, d, 0x31));
+    }
+
+    osc_load32_sse2(&args[i], src, count - i);
+}
+
+__attribute__((target("avx2")))
+static void osc_load64_avx2 (OscArgument* args, const uint8_t* src, size_t count) {
+
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i swap = _mm256_setr_epi8(
+        7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+        7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4, src += 32) {
+        __m256i v = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)src), swap);
+        __m256i a = _mm256_unpacklo_epi64(v, zero);
+        __m256i b = _mm256_unpackhi_epi64(v, zero);
+
+        _mm256_storeu_si256((__m256i*)&args[i + 0], _mm256_permute2x128_si256(a, b, 0x20));
+        _mm256_storeu_si256((__m256i*)&args[i + 2], _mm256_permute2x128_si256(a, b, 0x31));
+    }
+
+    osc_load64_sse2(&args[i], src, count - i);
+}
+
+#endif // OSC_SIMD_X86
+
+// ============================================================================
+
+size_t osc_simd_scan (const uint8_t* data, size_t size, size_t ptr) {
+
+    switch (osc_simd_level()) {
+#ifdef OSC_SIMD_X86
+        case OSC_SIMD_AVX2: return osc_scan_avx2(data, size, ptr);
+        case OSC_SIMD_SSE2: return osc_scan_sse2(data, size, ptr);
+#endif
+        default:            return osc_scan_scalar(data, size, ptr);
+    }
+}
+
+void osc_simd_load32 (OscArgument* args, const uint8_t* src, size_t count) {
+
+    switch (osc_simd_level()) {
+#ifdef OSC_SIMD_X86
+        case OSC_SIMD_AVX2: osc_load32_avx2(args, src, count); break;
+        case OSC_SIMD_SSE2: osc_load32_sse2(args, src, count); break;
+#endif
+        default:            osc_load32_scalar(args, src, count); break;
+    }
+}
+
+void osc_simd_load64 (OscArgument* args, const uint8_t* src, size_t count) {
+
+    switch (osc_simd_level()) {
+#ifdef OSC_SIMD_X86
+        case OSC_SIMD_AVX2: osc_load64_avx2(args, src, count); break;
+        case OSC_SIMD_SSE2: osc_load64_sse2(args, src, count); break;
+#endif
+        default:            osc_load64_scalar(args, src, count); break;
+    }
+}
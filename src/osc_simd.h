@@ -0,0 +1,41 @@
+#ifndef OSC_SIMD_H
+#define OSC_SIMD_H
+
+#include "osc.h"
+
+// ============================================================================
+// Internal: vectorized NUL scanning and big-endian conversion. The widest
+// instruction set supported by the CPU is picked at run time, building with
+// OSC_NO_SIMD leaves only the scalar code.
+
+#if !defined(OSC_NO_SIMD) && defined(__GNUC__) && defined(__x86_64__)
+#define OSC_SIMD_X86    1
+#endif
+
+// Instruction set levels
+#define OSC_SIMD_SCALAR     0
+#define OSC_SIMD_SSE2       1
+#define OSC_SIMD_AVX2       2
+
+// Shortest run of numeric arguments converted in bulk
+#ifndef OSC_SIMD_MIN_RUN
+#define OSC_SIMD_MIN_RUN    4
+#endif
+
+// Current level, and a way to lower it (tests, benchmarks). Levels above
+// what the CPU supports are clamped.
+int  osc_simd_level     (void);
+void osc_simd_set_level (int level);
+
+// Returns the offset past the first NUL at or after ptr, 0 if there is none
+// before size
+size_t osc_simd_scan (const uint8_t* data, size_t size, size_t ptr);
+
+// Converts count big-endian 32 / 64-bit values at src into args[].i32 /
+// args[].i64. The rest of each argument is cleared.
+void osc_simd_load32 (OscArgument* args, const uint8_t* src, size_t count);
+void osc_simd_load64 (OscArgument* args, const uint8_t* src, size_t count);
+
+// ============================================================================
+
+#endif // OSC_SIMD_H
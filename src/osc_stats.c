@@ -0,0 +1,170 @@
+#include "osc_stats.h"
+
+#include <string.h>
+
+#ifdef OSC_STATS
+
+#include <pthread.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// ============================================================================
+
+// Per-thread counters, linked while the thread lives
+typedef struct _OscStatsSlot {
+
+    OscStats                stats;
+    int                     linked;
+    struct _OscStatsSlot*   next;
+
+} OscStatsSlot;
+
+static __thread OscStatsSlot osc_stats_slot;
+
+static pthread_mutex_t  osc_stats_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t   osc_stats_once = PTHREAD_ONCE_INIT;
+static pthread_key_t    osc_stats_key;
+
+static OscStatsSlot*    osc_stats_slots = NULL;  // Live threads
+static OscStats         osc_stats_exited;        // Totals of exited threads
+
+// ============================================================================
+
+static void osc_stats_add (OscStats* dst, const OscStats* src) {
+
+    const uint64_t* s = (const uint64_t*)src;
+    uint64_t*       d = (uint64_t*)dst;
+
+    // Maxima are the last two fields
+    const size_t num = sizeof(OscStats) / sizeof(uint64_t);
+    for (size_t i=0; i<num - 2; ++i) {
+        d[i] += __atomic_load_n(&s[i], __ATOMIC_RELAXED);
+    }
+
+    for (size_t i=num - 2; i<num; ++i) {
+        uint64_t v = __atomic_load_n(&s[i], __ATOMIC_RELAXED);
+        if (v > d[i]) d[i] = v;
+    }
+}
+
+// Folds the counters of an exiting thread into the totals
+static void osc_stats_exit (void* arg) {
+
+    OscStatsSlot* slot = (OscStatsSlot*)arg;
+
+    pthread_mutex_lock(&osc_stats_lock);
+
+    osc_stats_add(&osc_stats_exited, &slot->stats);
+    for (OscStatsSlot** p = &osc_stats_slots; *p; p = &(*p)->next) {
+        if (*p == slot) {
+            *p = slot->next;
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&osc_stats_lock);
+}
+
+static void osc_stats_init (void) {
+    pthread_key_create(&osc_stats_key, osc_stats_exit);
+}
+
+OscStats* osc_stats_local (void) {
+
+    OscStatsSlot* slot = &osc_stats_slot;
+
+    // First use on this thread
+    if (!slot->linked) {
+        pthread_once(&osc_stats_once, osc_stats_init);
+        pthread_setspecific(osc_stats_key, slot);
+
+        pthread_mutex_lock(&osc_stats_lock);
+        slot->next      = osc_stats_slots;
+        osc_stats_slots = slot;
+        slot->linked    = 1;
+        pthread_mutex_unlock(&osc_stats_lock);
+    }
+
+    return &slot->stats;
+}
+
+uint64_t osc_stats_clock (void) {
+
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+void osc_stats_parsed (uint64_t start, size_t size, int ok) {
+
+    uint64_t  time = osc_stats_clock() - start;
+    OscStats* s    = osc_stats_local();
+
+    if (ok) {
+        OSC_STAT_ADD(packets_parsed, 1);
+        OSC_STAT_ADD(bytes_in, size);
+    }
+
+    OSC_STAT_ADD(parse_cycles, time);
+    if (time > s->parse_cycles_max) {
+        __atomic_store_n(&s->parse_cycles_max, time, __ATOMIC_RELAXED);
+    }
+}
+
+void osc_stats_encoded (uint64_t start, size_t size, int ok) {
+
+    uint64_t  time = osc_stats_clock() - start;
+    OscStats* s    = osc_stats_local();
+
+    if (ok) {
+        OSC_STAT_ADD(packets_encoded, 1);
+        OSC_STAT_ADD(bytes_out, size);
+    }
+
+    OSC_STAT_ADD(encode_cycles, time);
+    if (time > s->encode_cycles_max) {
+        __atomic_store_n(&s->encode_cycles_max, time, __ATOMIC_RELAXED);
+    }
+}
+
+#endif // OSC_STATS
+
+// ============================================================================
+
+int osc_stats_snapshot (OscStats* stats) {
+
+    memset((void*)stats, 0, sizeof(OscStats));
+
+#ifdef OSC_STATS
+    pthread_mutex_lock(&osc_stats_lock);
+
+    osc_stats_add(stats, &osc_stats_exited);
+    for (OscStatsSlot* slot = osc_stats_slots; slot; slot = slot->next) {
+        osc_stats_add(stats, &slot->stats);
+    }
+
+    pthread_mutex_unlock(&osc_stats_lock);
+    return 0;
+#else
+    return -1;
+#endif
+}
+
+int osc_stats_thread (OscStats* stats) {
+
+    memset((void*)stats, 0, sizeof(OscStats));
+
+#ifdef OSC_STATS
+    osc_stats_add(stats, osc_stats_local());
+    return 0;
+#else
+    return -1;
+#endif
+}
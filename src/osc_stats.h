@@ -0,0 +1,43 @@
+#ifndef OSC_STATS_H
+#define OSC_STATS_H
+
+#include "osc.h"
+
+// ============================================================================
+// Internal: instrumentation hooks. They compile to nothing unless the
+// library is built with OSC_STATS.
+
+#ifdef OSC_STATS
+
+OscStats* osc_stats_local (void);
+uint64_t  osc_stats_clock (void);
+
+void osc_stats_parsed  (uint64_t start, size_t size, int ok);
+void osc_stats_encoded (uint64_t start, size_t size, int ok);
+
+// Counters are only written by their thread, relaxed stores keep reads from
+// other threads tear-free
+#define OSC_STAT_ADD(field, n) do {                                         \
+        OscStats* s_ = osc_stats_local();                                   \
+        __atomic_store_n(&s_->field, s_->field + (uint64_t)(n), __ATOMIC_RELAXED); \
+    } while (0)
+
+#define OSC_STAT_START(t)               uint64_t t = osc_stats_clock()
+#define OSC_STAT_PARSED(t, size, ok)    osc_stats_parsed(t, size, ok)
+#define OSC_STAT_ENCODED(t, size, ok)   osc_stats_encoded(t, size, ok)
+#define OSC_STAT_REJECT(err)            OSC_STAT_ADD(rejects[err], 1)
+#define OSC_STAT_ALLOC(size)            do { OSC_STAT_ADD(allocs, 1); OSC_STAT_ADD(alloc_bytes, size); } while (0)
+
+#else
+
+#define OSC_STAT_START(t)
+#define OSC_STAT_PARSED(t, size, ok)    ((void)0)
+#define OSC_STAT_ENCODED(t, size, ok)   ((void)0)
+#define OSC_STAT_REJECT(err)            ((void)0)
+#define OSC_STAT_ALLOC(size)            ((void)0)
+
+#endif
+
+// ============================================================================
+
+#endif // OSC_STATS_H
@@ -0,0 +1,288 @@
+#include "osc.h"
+
+#include <string.h>
+
+// ============================================================================
+
+// SLIP special bytes (RFC 1055)
+#define SLIP_END        0xC0
+#define SLIP_ESC        0xDB
+#define SLIP_ESC_END    0xDC
+#define SLIP_ESC_ESC    0xDD
+
+// Stream decoder
+struct _OscStreamDecoder {
+
+    int         mode;       // Framing
+    size_t      max_size;   // Max packet size
+
+    uint8_t*    buf;        // Partial packet
+    size_t      len;        // Partial packet length
+
+    size_t      need;       // Packet length (length prefixed)
+    size_t      hdr;        // Length prefix bytes received
+    int         esc;        // Escape pending (SLIP)
+};
+
+// ============================================================================
+
+OscStreamDecoder* osc_stream_decoder_create (int mode, size_t max_size) {
+
+    if ((mode != OSC_STREAM_LENGTH && mode != OSC_STREAM_SLIP) || max_size == 0) {
+        return NULL;
+    }
+
+    OscStreamDecoder* dec = (OscStreamDecoder*)osc_malloc(sizeof(OscStreamDecoder));
+    if (!dec) {
+        return NULL;
+    }
+
+    dec->buf = (uint8_t*)osc_malloc(max_size);
+    if (!dec->buf) {
+        osc_free((void*)dec);
+        return NULL;
+    }
+
+    dec->mode     = mode;
+    dec->max_size = max_size;
+
+    osc_stream_decoder_reset(dec);
+    return dec;
+}
+
+OscStreamDecoder* osc_stream_decoder_delete (OscStreamDecoder* dec) {
+
+    if (!dec) {
+        return NULL;
+    }
+
+    osc_free((void*)dec->buf);
+    osc_free((void*)dec);
+
+    return NULL;
+}
+
+void osc_stream_decoder_reset (OscStreamDecoder* dec) {
+    dec->len  = 0;
+    dec->need = 0;
+    dec->hdr  = 0;
+    dec->esc  = 0;
+}
+
+// ============================================================================
+
+static int osc_stream_decode_length (OscStreamDecoder* dec,
+                                     const uint8_t* data, size_t size,
+                                     OscPacketHandler handler, void* user) {
+
+    int    count = 0;
+    size_t ptr   = 0;
+
+    while (ptr < size) {
+
+        // Length prefix
+        if (dec->hdr < 4) {
+
+            // Whole packet within the chunk, pass it through
+            if (dec->hdr == 0 && size - ptr >= 4) {
+                size_t len = ((size_t)data[ptr + 0] << 24) |
+                             ((size_t)data[ptr + 1] << 16) |
+                             ((size_t)data[ptr + 2] <<  8) |
+                             ((size_t)data[ptr + 3]);
+
+                if (len > dec->max_size) {
+                    osc_stream_decoder_reset(dec);
+                    return -1;
+                }
+
+                if (size - ptr - 4 >= len) {
+                    if (len) {
+                        handler(&data[ptr + 4], len, user);
+                        count++;
+                    }
+                    ptr += 4 + len;
+                    continue;
+                }
+            }
+
+            dec->need = (dec->need << 8) | data[ptr++];
+            dec->hdr++;
+
+            if (dec->hdr == 4) {
+                if (dec->need > dec->max_size) {
+                    osc_stream_decoder_reset(dec);
+                    return -1;
+                }
+
+                // Empty packet
+                if (dec->need == 0) {
+                    dec->hdr = 0;
+                }
+            }
+
+            continue;
+        }
+
+        // Packet body
+        size_t take = dec->need - dec->len;
+        if (take > size - ptr) {
+            take = size - ptr;
+        }
+
+        memcpy(&dec->buf[dec->len], &data[ptr], take);
+        dec->len += take;
+        ptr      += take;
+
+        if (dec->len == dec->need) {
+            handler(dec->buf, dec->len, user);
+            count++;
+
+            dec->len  = 0;
+            dec->need = 0;
+            dec->hdr  = 0;
+        }
+    }
+
+    return count;
+}
+
+static int osc_stream_decode_slip (OscStreamDecoder* dec,
+                                   const uint8_t* data, size_t size,
+                                   OscPacketHandler handler, void* user) {
+
+    int    count = 0;
+    size_t ptr   = 0;
+
+    while (ptr < size) {
+
+        // Between packets, pass unescaped ones within the chunk through
+        if (dec->len == 0 && !dec->esc) {
+
+            while (ptr < size && data[ptr] == SLIP_END) ptr++;
+            if (ptr == size) break;
+
+            const uint8_t* end = (const uint8_t*)memchr(&data[ptr], SLIP_END, size - ptr);
+            if (end) {
+                size_t len = end - &data[ptr];
+                if (!memchr(&data[ptr], SLIP_ESC, len)) {
+
+                    if (len > dec->max_size) {
+                        osc_stream_decoder_reset(dec);
+                        return -1;
+                    }
+
+                    handler(&data[ptr], len, user);
+                    count++;
+
+                    ptr += len + 1;
+                    continue;
+                }
+            }
+        }
+
+        // Unescape into the buffer
+        uint8_t byte = data[ptr++];
+
+        if (dec->esc) {
+            dec->esc = 0;
+
+            if      (byte == SLIP_ESC_END) byte = SLIP_END;
+            else if (byte == SLIP_ESC_ESC) byte = SLIP_ESC;
+        }
+        else if (byte == SLIP_END) {
+            if (dec->len) {
+                handler(dec->buf, dec->len, user);
+                count++;
+                dec->len = 0;
+            }
+            continue;
+        }
+        else if (byte == SLIP_ESC) {
+            dec->esc = 1;
+            continue;
+        }
+
+        if (dec->len == dec->max_size) {
+            osc_stream_decoder_reset(dec);
+            return -1;
+        }
+
+        dec->buf[dec->len++] = byte;
+    }
+
+    return count;
+}
+
+int osc_stream_decode (OscStreamDecoder* dec, const uint8_t* data, size_t size,
+                       OscPacketHandler handler, void* user) {
+
+    if (dec->mode == OSC_STREAM_SLIP) {
+        return osc_stream_decode_slip(dec, data, size, handler, user);
+    }
+
+    return osc_stream_decode_length(dec, data, size, handler, user);
+}
+
+// ============================================================================
+
+size_t osc_stream_encoded_size (int mode, const uint8_t* data, size_t size) {
+
+    if (mode == OSC_STREAM_SLIP) {
+        size_t len = 2 + size;
+        for (size_t i=0; i<size; ++i) {
+            if (data[i] == SLIP_END || data[i] == SLIP_ESC) len++;
+        }
+        return len;
+    }
+
+    return 4 + size;
+}
+
+int osc_stream_encode (int mode, const uint8_t* data, size_t size,
+                       uint8_t* buf, size_t cap, size_t* pwritten) {
+
+    size_t len = osc_stream_encoded_size(mode, data, size);
+    if (len > cap) {
+        if (pwritten) *pwritten = len;
+        return -1;
+    }
+
+    size_t ptr = 0;
+
+    // Double END framing
+    if (mode == OSC_STREAM_SLIP) {
+        buf[ptr++] = SLIP_END;
+
+        for (size_t i=0; i<size; ++i) {
+            if (data[i] == SLIP_END) {
+                buf[ptr++] = SLIP_ESC;
+                buf[ptr++] = SLIP_ESC_END;
+            }
+            else if (data[i] == SLIP_ESC) {
+                buf[ptr++] = SLIP_ESC;
+                buf[ptr++] = SLIP_ESC_ESC;
+            }
+            else {
+                buf[ptr++] = data[i];
+            }
+        }
+
+        buf[ptr++] = SLIP_END;
+    }
+
+    // Length prefix
+    else {
+        for (size_t i=0; i<4; ++i) {
+            buf[ptr++] = ((size << (8 * i)) >> 24) & 0xFF;
+        }
+
+        memcpy(&buf[ptr], data, size);
+        ptr += size;
+    }
+
+    if (pwritten) {
+        *pwritten = ptr;
+    }
+
+    return 0;
+}
@@ -0,0 +1,279 @@
+#include "osc.h"
+
+#include <string.h>
+
+// ============================================================================
+
+// Argument location in the encoded data
+typedef struct _OscTemplateSlot {
+
+    uint32_t    offset; // Byte offset of the argument data
+    char        tag;    // Argument tag
+
+} OscTemplateSlot;
+
+struct _OscTemplate {
+
+    uint8_t*            data;       // Encoded packet
+    size_t              size;       // Encoded size
+
+    OscTemplateSlot*    slots;      // One per tag, wire order
+    size_t              num_slots;
+
+    uint32_t*           stamps;     // Bundle timestamp offsets, wire order
+    size_t              num_stamps;
+};
+
+// ============================================================================
+
+static void osc_template_count (const OscBundle* bundle, size_t* pslots, size_t* pstamps) {
+
+    (*pstamps)++;
+
+    for (const OscMessage* msg = bundle->messages; msg; msg = msg->next) {
+        *pslots += msg->num_args;
+    }
+
+    for (const OscBundle* bun = bundle->bundles; bun; bun = bun->next) {
+        osc_template_count(bun, pslots, pstamps);
+    }
+}
+
+// Records argument offsets of a message encoded at ptr, in the same layout
+// as osc_write_message()
+static void osc_template_map_message (OscTemplate* tpl, const OscMessage* msg, size_t ptr) {
+
+    // Address and tag strings
+    size_t len = strlen(msg->addr) + 1;
+    ptr += (len + 3) & ~(size_t)3;
+    ptr += (msg->num_args + 2 + 3) & ~(size_t)3;
+
+    for (size_t i=0; i<msg->num_args; ++i) {
+
+        OscTemplateSlot* slot = &tpl->slots[tpl->num_slots++];
+        slot->offset = (uint32_t)ptr;
+        slot->tag    = msg->tags[i];
+
+        switch (msg->tags[i]) {
+
+            case 'i':
+            case 'f':
+            case 'r':
+            case 'm':
+            case 'c':
+                ptr += 4;
+                break;
+
+            case 'h':
+            case 'd':
+            case 't':
+                ptr += 8;
+                break;
+
+            case 's':
+            case 'S':
+                len = strlen(msg->args[i].str) + 1;
+                ptr += (len + 3) & ~(size_t)3;
+                break;
+
+            case 'b':
+                len = 4 + (size_t)msg->args[i].blob.size;
+                ptr += (len + 3) & ~(size_t)3;
+                break;
+
+            // Data-less and array delimiters
+            default:
+                break;
+        }
+    }
+}
+
+static void osc_template_map_bundle (OscTemplate* tpl, const OscBundle* bundle, size_t ptr) {
+
+    tpl->stamps[tpl->num_stamps++] = (uint32_t)(ptr + 8);
+    ptr += 16;
+
+    for (const OscMessage* msg = bundle->messages; msg; msg = msg->next) {
+        osc_template_map_message(tpl, msg, ptr + 4);
+        ptr += 4 + osc_message_encoded_size(msg);
+    }
+
+    for (const OscBundle* bun = bundle->bundles; bun; bun = bun->next) {
+        osc_template_map_bundle(tpl, bun, ptr + 4);
+        ptr += 4 + osc_bundle_encoded_size(bun);
+    }
+}
+
+// Allocates the template, its tables and data in a single block
+static OscTemplate* osc_template_alloc (size_t size, size_t num_slots, size_t num_stamps) {
+
+    // Offsets must fit the slot tables
+    if (size > UINT32_MAX) {
+        return NULL;
+    }
+
+    size_t slots  = sizeof(OscTemplate);
+    size_t stamps = slots  + num_slots  * sizeof(OscTemplateSlot);
+    size_t data   = stamps + num_stamps * sizeof(uint32_t);
+
+    uint8_t* block = (uint8_t*)osc_malloc(data + size);
+    if (!block) {
+        return NULL;
+    }
+
+    OscTemplate* tpl = (OscTemplate*)block;
+    tpl->data       = block + data;
+    tpl->size       = size;
+    tpl->slots      = (OscTemplateSlot*)(block + slots);
+    tpl->num_slots  = 0;
+    tpl->stamps     = (uint32_t*)(block + stamps);
+    tpl->num_stamps = 0;
+
+    return tpl;
+}
+
+// ============================================================================
+
+OscTemplate* osc_template_message (const OscMessage* msg) {
+
+    size_t size = osc_message_encoded_size(msg);
+    if (!size) {
+        return NULL;
+    }
+
+    OscTemplate* tpl = osc_template_alloc(size, msg->num_args, 0);
+    if (!tpl) {
+        return NULL;
+    }
+
+    size_t written = 0;
+    if (osc_encode_message_into(msg, tpl->data, tpl->size, &written)) {
+        osc_free((void*)tpl);
+        return NULL;
+    }
+
+    osc_template_map_message(tpl, msg, 0);
+    return tpl;
+}
+
+OscTemplate* osc_template_bundle (const OscBundle* bundle) {
+
+    size_t size = osc_bundle_encoded_size(bundle);
+    if (!size) {
+        return NULL;
+    }
+
+    size_t num_slots  = 0;
+    size_t num_stamps = 0;
+    osc_template_count(bundle, &num_slots, &num_stamps);
+
+    OscTemplate* tpl = osc_template_alloc(size, num_slots, num_stamps);
+    if (!tpl) {
+        return NULL;
+    }
+
+    size_t written = 0;
+    if (osc_encode_bundle_into(bundle, tpl->data, tpl->size, &written)) {
+        osc_free((void*)tpl);
+        return NULL;
+    }
+
+    osc_template_map_bundle(tpl, bundle, 0);
+    return tpl;
+}
+
+OscTemplate* osc_template_delete (const OscTemplate* tpl) {
+
+    if (tpl) {
+        osc_free((void*)tpl);
+    }
+
+    return NULL;
+}
+
+const uint8_t* osc_template_data (const OscTemplate* tpl, size_t* psize) {
+
+    if (psize) {
+        *psize = tpl->size;
+    }
+
+    return tpl->data;
+}
+
+// ============================================================================
+
+// Overwrites a slot with the value in arg if its tag is one of the accepted
+static int osc_template_patch (OscTemplate* tpl, size_t index, const char* accept,
+                               const OscArgument* arg) {
+
+    if (index >= tpl->num_slots) {
+        return -1;
+    }
+
+    const OscTemplateSlot* slot = &tpl->slots[index];
+    if (!strchr(accept, slot->tag)) {
+        return -1;
+    }
+
+    uint8_t* dst = &tpl->data[slot->offset];
+    switch (slot->tag) {
+
+        case 'c':
+            dst[3] = arg->i32 & 0x7F;
+            break;
+
+        case 'h':
+        case 'd':
+        case 't':
+            for (size_t j=0; j<8; ++j) dst[j] = arg->b[7 - j];
+            break;
+
+        default:
+            for (size_t j=0; j<4; ++j) dst[j] = arg->b[3 - j];
+            break;
+    }
+
+    return 0;
+}
+
+int osc_template_set_i32 (OscTemplate* tpl, size_t index, int32_t value) {
+
+    OscArgument arg;
+    arg.i32 = value;
+    return osc_template_patch(tpl, index, "irmc", &arg);
+}
+
+int osc_template_set_f32 (OscTemplate* tpl, size_t index, float value) {
+
+    OscArgument arg;
+    arg.f32 = value;
+    return osc_template_patch(tpl, index, "f", &arg);
+}
+
+int osc_template_set_i64 (OscTemplate* tpl, size_t index, int64_t value) {
+
+    OscArgument arg;
+    arg.i64 = value;
+    return osc_template_patch(tpl, index, "ht", &arg);
+}
+
+int osc_template_set_f64 (OscTemplate* tpl, size_t index, double value) {
+
+    OscArgument arg;
+    arg.f64 = value;
+    return osc_template_patch(tpl, index, "d", &arg);
+}
+
+int osc_template_set_timestamp (OscTemplate* tpl, size_t index, int64_t timestamp) {
+
+    if (index >= tpl->num_stamps) {
+        return -1;
+    }
+
+    uint8_t* dst = &tpl->data[tpl->stamps[index]];
+    for (size_t i=0; i<8; ++i) {
+        dst[i] = (((uint64_t)timestamp << (8 * i)) >> 56) & 0xFF;
+    }
+
+    return 0;
+}
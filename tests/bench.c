@@ -0,0 +1,342 @@
+#include "osc.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// ============================================================================
+// Throughput benchmark. Prints one JSON object per corpus and operation:
+//
+//   {"corpus": "...", "op": "...", "packets": N, "msgs_per_s": ..,
+//    "ns_per_msg": .., "bytes_per_s": .., "allocs_per_packet": ..}
+//
+// Usage: osc_bench [-t min_ms] [-c corpus]
+
+// Packets handled between clock reads
+#define BENCH_BATCH 256
+
+static size_t allocCount = 0;
+
+// Atomic, the parallel parser allocates on its worker threads
+void* osc_malloc (size_t size) {
+    __atomic_add_fetch(&allocCount, 1, __ATOMIC_RELAXED);
+    return malloc(size);
+}
+
+void osc_free (void* ptr) {
+    free(ptr);
+}
+
+// ============================================================================
+
+typedef struct _BenchCorpus {
+
+    const char* name;
+    OscBundle*  bundle;     // Source bundle, a bare message if single
+    int         single;     // Encode as a message
+    size_t      num_msgs;   // Messages per packet
+
+    uint8_t*    data;       // Encoded packet
+    size_t      size;
+
+} BenchCorpus;
+
+typedef struct _BenchResult {
+
+    size_t  packets;
+    double  seconds;
+    size_t  allocs;
+
+} BenchResult;
+
+static double bench_clock (void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static void bench_report (const BenchCorpus* corpus, const char* op, const BenchResult* res) {
+
+    double msgs = (double)res->packets * (double)corpus->num_msgs;
+
+    printf("{\"corpus\": \"%s\", \"op\": \"%s\", \"packets\": %zu, "
+           "\"msgs_per_s\": %.0f, \"ns_per_msg\": %.2f, \"bytes_per_s\": %.0f, "
+           "\"allocs_per_packet\": %.2f}\n",
+           corpus->name, op, res->packets,
+           msgs / res->seconds,
+           res->seconds * 1e9 / msgs,
+           (double)res->packets * (double)corpus->size / res->seconds,
+           (double)res->allocs / (double)res->packets);
+
+    fflush(stdout);
+}
+
+// ============================================================================
+
+static OscMessage* bench_message (const char* addr, const char* tags) {
+
+    OscMessage* msg = osc_message_create(tags);
+    msg->addr = osc_strdup(addr);
+
+    for (size_t i=0; i<msg->num_args; ++i) {
+        switch (tags[i]) {
+            case 'i': msg->args[i].i32 = (int32_t)i * 7;              break;
+            case 'f': msg->args[i].f32 = (float)i / 512.0f;           break;
+            case 'd': msg->args[i].f64 = (double)i * 0.001;           break;
+            case 's': msg->args[i].str = osc_strdup("value string");  break;
+        }
+    }
+
+    return msg;
+}
+
+static void bench_corpus_single (BenchCorpus* corpus, const char* name, OscMessage* msg) {
+
+    corpus->name     = name;
+    corpus->bundle   = osc_bundle_create(OSC_IMMEDIATE);
+    corpus->single   = 1;
+    corpus->num_msgs = 1;
+    osc_bundle_add_message(corpus->bundle, msg);
+
+    corpus->data = NULL;
+    osc_encode_message(msg, &corpus->data, &corpus->size);
+}
+
+static void bench_corpora (BenchCorpus* corpora, size_t* pcount) {
+
+    size_t count = 0;
+
+    // A single float, the most common control message
+    bench_corpus_single(&corpora[count++], "float1",
+                        bench_message("/mixer/channel/12/fader", "f"));
+
+    // Long string
+    OscMessage* msg = bench_message("/display/text", "s");
+    char text[1024];
+    memset(text, 'x', sizeof(text) - 1);
+    text[sizeof(text) - 1] = 0;
+    osc_free(msg->args[0].str);
+    msg->args[0].str = osc_strdup(text);
+    bench_corpus_single(&corpora[count++], "string1k", msg);
+
+    // Wide float vector (512 channel DMX universe)
+    char tags[513];
+    memset(tags, 'f', 512);
+    tags[512] = 0;
+    bench_corpus_single(&corpora[count++], "float512",
+                        bench_message("/dmx/universe/1", tags));
+
+    // 500 messages in 10 nested bundles of 50
+    BenchCorpus* corpus = &corpora[count++];
+    corpus->name     = "nested500";
+    corpus->bundle   = osc_bundle_create(OSC_IMMEDIATE);
+    corpus->single   = 0;
+    corpus->num_msgs = 500;
+
+    for (int b=0; b<10; ++b) {
+        OscBundle* inner = osc_bundle_create(OSC_IMMEDIATE + b);
+        for (int m=0; m<50; ++m) {
+            char addr[64];
+            snprintf(addr, sizeof(addr), "/scene/%d/object/%d/transform", b, m);
+            osc_bundle_add_message(inner, bench_message(addr, (m & 1) ? "ifff" : "sfd"));
+        }
+        osc_bundle_add_bundle(corpus->bundle, inner);
+    }
+
+    corpus->data = NULL;
+    osc_encode_bundle(corpus->bundle, &corpus->data, &corpus->size);
+
+    *pcount = count;
+}
+
+// ============================================================================
+
+static void bench_parse (const BenchCorpus* corpus, double min_s, BenchResult* parse,
+                         BenchResult* del) {
+
+    OscBundle* out [BENCH_BATCH];
+
+    memset(parse, 0, sizeof(*parse));
+    memset(del,   0, sizeof(*del));
+
+    while (parse->seconds < min_s) {
+        size_t allocs = allocCount;
+        double t0     = bench_clock();
+
+        for (size_t i=0; i<BENCH_BATCH; ++i) {
+            out[i] = osc_parse(corpus->data, corpus->size);
+        }
+
+        double t1 = bench_clock();
+        parse->allocs  += allocCount - allocs;
+        parse->seconds += t1 - t0;
+        parse->packets += BENCH_BATCH;
+
+        for (size_t i=0; i<BENCH_BATCH; ++i) {
+            osc_bundle_delete(out[i]);
+        }
+
+        del->seconds += bench_clock() - t1;
+        del->packets += BENCH_BATCH;
+    }
+}
+
+static void bench_parallel (const BenchCorpus* corpus, OscParser* parser, double min_s,
+                            BenchResult* res) {
+
+    OscBundle* out [BENCH_BATCH];
+
+    memset(res, 0, sizeof(*res));
+
+    while (res->seconds < min_s) {
+        size_t allocs = allocCount;
+        double t0     = bench_clock();
+
+        for (size_t i=0; i<BENCH_BATCH; ++i) {
+            out[i] = osc_parse_parallel(parser, corpus->data, corpus->size);
+        }
+
+        res->seconds += bench_clock() - t0;
+        res->allocs  += allocCount - allocs;
+        res->packets += BENCH_BATCH;
+
+        for (size_t i=0; i<BENCH_BATCH; ++i) {
+            osc_bundle_delete(out[i]);
+        }
+    }
+}
+
+static void bench_encode (const BenchCorpus* corpus, double min_s, BenchResult* res) {
+
+    uint8_t* out [BENCH_BATCH];
+    size_t   size = 0;
+
+    memset(res, 0, sizeof(*res));
+
+    while (res->seconds < min_s) {
+        size_t allocs = allocCount;
+        double t0     = bench_clock();
+
+        for (size_t i=0; i<BENCH_BATCH; ++i) {
+            out[i] = NULL;
+            if (corpus->single) osc_encode_message(corpus->bundle->messages, &out[i], &size);
+            else                osc_encode_bundle(corpus->bundle, &out[i], &size);
+        }
+
+        res->seconds += bench_clock() - t0;
+        res->allocs  += allocCount - allocs;
+        res->packets += BENCH_BATCH;
+
+        for (size_t i=0; i<BENCH_BATCH; ++i) {
+            osc_free((void*)out[i]);
+        }
+    }
+}
+
+static void bench_validate (const BenchCorpus* corpus, double min_s, BenchResult* res) {
+
+    memset(res, 0, sizeof(*res));
+
+    while (res->seconds < min_s) {
+        size_t allocs = allocCount;
+        double t0     = bench_clock();
+
+        for (size_t i=0; i<BENCH_BATCH; ++i) {
+            osc_validate(corpus->data, corpus->size, NULL);
+        }
+
+        res->seconds += bench_clock() - t0;
+        res->allocs  += allocCount - allocs;
+        res->packets += BENCH_BATCH;
+    }
+}
+
+static void bench_packet (const BenchCorpus* corpus, double min_s, BenchResult* res) {
+
+    OscPacket* out [BENCH_BATCH];
+
+    memset(res, 0, sizeof(*res));
+
+    while (res->seconds < min_s) {
+        size_t allocs = allocCount;
+        double t0     = bench_clock();
+
+        for (size_t i=0; i<BENCH_BATCH; ++i) {
+            out[i] = osc_parse_packet(corpus->data, corpus->size);
+        }
+
+        res->seconds += bench_clock() - t0;
+        res->allocs  += allocCount - allocs;
+        res->packets += BENCH_BATCH;
+
+        for (size_t i=0; i<BENCH_BATCH; ++i) {
+            osc_packet_delete(out[i]);
+        }
+    }
+}
+
+// ============================================================================
+
+int main (int argc, char* argv[]) {
+
+    double      min_s  = 0.2;
+    const char* filter = NULL;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "t:c:h")) != -1) {
+        switch (opt) {
+            case 't': min_s  = atof(optarg) * 1e-3; break;
+            case 'c': filter = optarg;              break;
+            default:
+                fprintf(stderr, "usage: %s [-t min_ms] [-c corpus]\n", argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    // One worker per additional CPU
+    long       cpus   = sysconf(_SC_NPROCESSORS_ONLN);
+    OscParser* parser = osc_parser_create(cpus > 1 ? (size_t)cpus - 1 : 0);
+    if (!parser) {
+        fprintf(stderr, "cannot create parser\n");
+        return 1;
+    }
+
+    BenchCorpus corpora [8];
+    size_t      count = 0;
+    bench_corpora(corpora, &count);
+
+    for (size_t i=0; i<count; ++i) {
+        const BenchCorpus* corpus = &corpora[i];
+        if (filter && strcmp(filter, corpus->name)) continue;
+
+        BenchResult parse, del, res;
+
+        bench_parse(corpus, min_s, &parse, &del);
+        bench_report(corpus, "osc_parse", &parse);
+        bench_report(corpus, "osc_bundle_delete", &del);
+
+        if (!corpus->single) {
+            bench_parallel(corpus, parser, min_s, &res);
+            bench_report(corpus, "osc_parse_parallel", &res);
+        }
+
+        bench_encode(corpus, min_s, &res);
+        bench_report(corpus, corpus->single ? "osc_encode_message" : "osc_encode_bundle", &res);
+
+        bench_validate(corpus, min_s, &res);
+        bench_report(corpus, "osc_validate", &res);
+
+        bench_packet(corpus, min_s, &res);
+        bench_report(corpus, "osc_parse_packet", &res);
+    }
+
+    osc_parser_delete(parser);
+
+    for (size_t i=0; i<count; ++i) {
+        osc_free((void*)corpora[i].data);
+        osc_bundle_delete(corpora[i].bundle);
+    }
+
+    return 0;
+}
@@ -0,0 +1,215 @@
+#include "osc.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// ============================================================================
+// Parser fuzzing harness. Built with -DOSC_LIBFUZZER it only provides the
+// libFuzzer entry point. Otherwise a standalone driver replays the files
+// given on the command line (AFL, crash reproduction) or, without files,
+// mutates built-in seed packets.
+//
+// Usage: osc_fuzz [-n iterations] [-s seed] [file ...]
+
+void* osc_malloc (size_t size) {
+    return malloc(size);
+}
+
+void osc_free (void* ptr) {
+    free(ptr);
+}
+
+// ============================================================================
+
+#define FUZZ_CHECK(cond) do {                                               \
+        if (!(cond)) {                                                      \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            abort();                                                        \
+        }                                                                   \
+    } while (0)
+
+static OscView fuzz_view;
+
+extern "C" int LLVMFuzzerTestOneInput (const uint8_t* data, size_t size) {
+
+    // Copy so that reads past the end are caught by the sanitizers
+    uint8_t* copy = (uint8_t*)malloc(size ? size : 1);
+    memcpy(copy, data, size);
+
+    OscParseResult res;
+    OscInfo        info;
+
+    int valid  = osc_validate_result(copy, size, OSC_PARSE_LENIENT, &info, &res) == 0;
+    int strict = osc_validate_result(copy, size, OSC_PARSE_STRICT, NULL, NULL) == 0;
+
+    FUZZ_CHECK(valid || res.error != OSC_ERR_NONE);
+    FUZZ_CHECK(valid || !strict);
+    FUZZ_CHECK(res.depth <= OSC_PARSE_MAX_DEPTH);
+
+    // The allocating parsers agree with the validator
+    OscBundle* bundle = osc_parse_result(NULL, copy, size, OSC_PARSE_LENIENT, &res);
+    FUZZ_CHECK((bundle != NULL) == valid);
+
+    OscPacket* packet = osc_parse_packet(copy, size);
+    FUZZ_CHECK((packet != NULL) == valid);
+
+    if (packet) {
+        FUZZ_CHECK(packet->num_messages == info.num_messages);
+        FUZZ_CHECK(packet->num_args == info.num_args);
+    }
+
+    osc_parse_view(copy, size, &fuzz_view);
+
+    // Parsed packets encode and parse again
+    if (bundle) {
+        uint8_t* out      = NULL;
+        size_t   out_size = 0;
+        FUZZ_CHECK(osc_encode_bundle(bundle, &out, &out_size) == 0);
+        FUZZ_CHECK(osc_validate(out, out_size, NULL) == 0);
+        osc_free((void*)out);
+    }
+
+    osc_packet_delete(packet);
+    osc_bundle_delete(bundle);
+    free(copy);
+
+    return 0;
+}
+
+#ifndef OSC_LIBFUZZER
+
+// ============================================================================
+
+static uint64_t fuzz_state = 0x9E3779B97F4A7C15ULL;
+
+static uint32_t fuzz_rand (void) {
+    fuzz_state ^= fuzz_state << 13;
+    fuzz_state ^= fuzz_state >> 7;
+    fuzz_state ^= fuzz_state << 17;
+    return (uint32_t)fuzz_state;
+}
+
+static uint8_t* fuzz_read (const char* path, size_t* psize) {
+
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        return NULL;
+    }
+
+    size_t   cap  = 4096;
+    size_t   size = 0;
+    uint8_t* data = (uint8_t*)malloc(cap);
+
+    for (size_t n; (n = fread(&data[size], 1, cap - size, f)) > 0; ) {
+        size += n;
+        if (size == cap) {
+            cap *= 2;
+            data = (uint8_t*)realloc(data, cap);
+        }
+    }
+
+    fclose(f);
+    *psize = size;
+    return data;
+}
+
+// Seed packets: a bare message and nested bundles with every argument type
+static void fuzz_seeds (uint8_t** seeds, size_t* sizes) {
+
+    OscMessage* msg = osc_message_create("ifsbhdtcrmTFNI[S]");
+    msg->addr = osc_strdup("/fuzz/seed");
+    msg->args[2].str       = osc_strdup("string");
+    msg->args[3].blob.data = (const uint8_t*)"blob";
+    msg->args[3].blob.size = 4;
+    msg->args[15].str      = osc_strdup("symbol");
+
+    seeds[0] = NULL;
+    osc_encode_message(msg, &seeds[0], &sizes[0]);
+
+    OscBundle* bundle = osc_bundle_create(OSC_IMMEDIATE);
+    OscBundle* inner  = osc_bundle_create(1234);
+    osc_bundle_add_message(inner, msg);
+    osc_bundle_add_bundle(bundle, inner);
+
+    seeds[1] = NULL;
+    osc_encode_bundle(bundle, &seeds[1], &sizes[1]);
+
+    osc_bundle_delete(bundle);
+}
+
+// Flips, overwrites with interesting values, truncates or extends
+static size_t fuzz_mutate (uint8_t* data, size_t size, size_t cap) {
+
+    static const uint8_t values[] = {0x00, 0x01, 0x7F, 0x80, 0xFF, '/', ',', '#', '[', ']', 's', 'b'};
+
+    size_t count = 1 + fuzz_rand() % 4;
+    for (size_t i=0; i<count && size; ++i) {
+        size_t pos = fuzz_rand() % size;
+        switch (fuzz_rand() % 5) {
+            case 0: data[pos] ^= (uint8_t)(1 << (fuzz_rand() % 8));                  break;
+            case 1: data[pos]  = values[fuzz_rand() % sizeof(values)];               break;
+            case 2: data[pos & ~(size_t)3] = (uint8_t)fuzz_rand();                   break;
+            case 3: size = pos;                                                      break;
+            case 4: if (size < cap) data[size++] = (uint8_t)fuzz_rand();             break;
+        }
+    }
+
+    return size;
+}
+
+int main (int argc, char* argv[]) {
+
+    size_t iterations = 100000;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:s:h")) != -1) {
+        switch (opt) {
+            case 'n': iterations = strtoul(optarg, NULL, 0);                 break;
+            case 's': fuzz_state = strtoull(optarg, NULL, 0) | 1;            break;
+            default:
+                fprintf(stderr, "usage: %s [-n iterations] [-s seed] [file ...]\n", argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    // Replay files
+    if (optind < argc) {
+        for (int i=optind; i<argc; ++i) {
+            size_t   size = 0;
+            uint8_t* data = fuzz_read(argv[i], &size);
+            if (!data) {
+                fprintf(stderr, "%s: cannot read\n", argv[i]);
+                return 1;
+            }
+
+            LLVMFuzzerTestOneInput(data, size);
+            free(data);
+        }
+        return 0;
+    }
+
+    // Mutate seeds
+    uint8_t* seeds [2];
+    size_t   sizes [2];
+    fuzz_seeds(seeds, sizes);
+
+    uint8_t buf [1024];
+    for (size_t i=0; i<iterations; ++i) {
+        size_t seed = fuzz_rand() % 2;
+        size_t size = sizes[seed] < sizeof(buf) ? sizes[seed] : sizeof(buf);
+        memcpy(buf, seeds[seed], size);
+
+        size = fuzz_mutate(buf, size, sizeof(buf));
+        LLVMFuzzerTestOneInput(buf, size);
+    }
+
+    printf("%zu inputs\n", iterations);
+
+    osc_free(seeds[0]);
+    osc_free(seeds[1]);
+    return 0;
+}
+
+#endif // OSC_LIBFUZZER
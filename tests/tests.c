@@ -1,20 +1,31 @@
 #include "osc.h"
+#include "osc_net.h"
+#include "osc_codec.hpp"
+#include "osc_simd.h"
+#include "router.h"
 
 #include <gtest/gtest.h>
 
 #include <stdio.h>
+#include <unistd.h>
+
+#include <thread>
+
+#include <netinet/in.h>
+#include <arpa/inet.h>
 
 // ============================================================================
 
 static int32_t allocCount = 0;
 
+// Atomic, the parallel parser allocates on its worker threads
 void* osc_malloc (size_t size) {
-    allocCount++;
+    __atomic_add_fetch(&allocCount, 1, __ATOMIC_RELAXED);
     return malloc(size);
 }
 
 void osc_free (void* ptr) {
-    allocCount--;
+    __atomic_sub_fetch(&allocCount, 1, __ATOMIC_RELAXED);
     free(ptr);
 }
 
@@ -554,3 +565,2344 @@ TEST(testRandomRoundtrip, Random)
     }
 }
 
+
+// ============================================================================
+
+TEST(testParseView, Reference2)
+{
+    uint8_t* data = NULL;
+    size_t   size = 0;
+    EXPECT_TRUE(load_file("tests/assets/ref2.bin", &data, &size) == 0);
+
+    allocCount = 0;
+
+    OscView view;
+    EXPECT_EQ(osc_parse_view(data, size, &view), 0);
+    EXPECT_EQ(allocCount, 0);
+
+    EXPECT_EQ(view.num_bundles, 1);
+    EXPECT_EQ(view.bundles[0].timestamp, OSC_IMMEDIATE);
+    EXPECT_EQ(view.num_messages, 1);
+
+    const OscMessageView* msg = &view.messages[0];
+
+    EXPECT_STREQ(msg->addr, "/foo");
+    EXPECT_STREQ(msg->tags, "iisff");
+    EXPECT_EQ(msg->args[0].i32, 1000);
+    EXPECT_EQ(msg->args[1].i32, -1);
+    EXPECT_STREQ(msg->args[2].str, "hello");
+    EXPECT_FLOAT_EQ(msg->args[3].f32, 1.234f);
+    EXPECT_FLOAT_EQ(msg->args[4].f32, 5.678f);
+
+    // Strings are borrowed from the buffer
+    EXPECT_GE((const uint8_t*)msg->addr, data);
+    EXPECT_LT((const uint8_t*)msg->args[2].str, data + size);
+
+    free(data);
+}
+
+TEST(testParseView, Bundle)
+{
+    allocCount = 0;
+
+    OscMessage* msg1 = osc_message_create("si");
+    msg1->addr = osc_strdup("/root/1");
+    msg1->args[0].str = osc_strdup("test");
+    msg1->args[1].i32 = 1234;
+
+    OscMessage* msg2 = osc_message_create("d");
+    msg2->addr = osc_strdup("/root/2");
+    msg2->args[0].f64 = 1.2345;
+
+    OscBundle* bundle = osc_bundle_create(5678);
+    OscBundle* inner  = osc_bundle_create(9012);
+    osc_bundle_add_message(bundle, msg1);
+    osc_bundle_add_message(inner, msg2);
+    osc_bundle_add_bundle(bundle, inner);
+
+    uint8_t* data = NULL;
+    size_t   size = 0;
+    EXPECT_TRUE(osc_encode_bundle(bundle, &data, &size) == 0);
+
+    int32_t allocs = allocCount;
+
+    OscView view;
+    EXPECT_EQ(osc_parse_view(data, size, &view), 0);
+    EXPECT_EQ(allocCount, allocs);
+
+    EXPECT_EQ(view.num_bundles, 2);
+    EXPECT_EQ(view.num_messages, 2);
+    EXPECT_EQ(view.num_args, 3);
+
+    EXPECT_EQ(view.bundles[0].timestamp, 5678);
+    EXPECT_EQ(view.bundles[0].parent, -1);
+    EXPECT_EQ(view.bundles[0].first, 0);
+    EXPECT_EQ(view.bundles[0].count, 2);
+
+    EXPECT_EQ(view.bundles[1].timestamp, 9012);
+    EXPECT_EQ(view.bundles[1].parent, 0);
+    EXPECT_EQ(view.bundles[1].first, 1);
+    EXPECT_EQ(view.bundles[1].count, 1);
+
+    // Wire order
+    EXPECT_STREQ(view.messages[0].addr, "/root/1");
+    EXPECT_EQ(view.messages[0].bundle, 0);
+    EXPECT_STREQ(view.messages[0].args[0].str, "test");
+    EXPECT_EQ(view.messages[0].args[1].i32, 1234);
+
+    EXPECT_STREQ(view.messages[1].addr, "/root/2");
+    EXPECT_EQ(view.messages[1].bundle, 1);
+    EXPECT_DOUBLE_EQ(view.messages[1].args[0].f64, 1.2345);
+
+    // Truncated
+    EXPECT_NE(osc_parse_view(data, size - 4, &view), 0);
+
+    osc_free(data);
+    osc_bundle_delete(bundle);
+
+    EXPECT_EQ(allocCount, 0);
+}
+
+// ============================================================================
+
+TEST(testArena, Parse)
+{
+    allocCount = 0;
+
+    OscMessage* msg1 = osc_message_create("si");
+    msg1->addr = osc_strdup("/root/1");
+    msg1->args[0].str = osc_strdup("test");
+    msg1->args[1].i32 = 1234;
+
+    OscBundle* bundle = osc_bundle_create(5678);
+    osc_bundle_add_message(bundle, msg1);
+    osc_bundle_add_bundle(bundle, osc_bundle_create(9012));
+
+    uint8_t* data = NULL;
+    size_t   size = 0;
+    EXPECT_TRUE(osc_encode_bundle(bundle, &data, &size) == 0);
+
+    osc_bundle_delete(bundle);
+
+    OscArena* arena = osc_arena_create(4096);
+    EXPECT_NE(arena, nullptr);
+
+    int32_t allocs = allocCount;
+
+    for (size_t i=0; i<100; ++i) {
+        OscBundle* dec = osc_parse_ex(arena, data, size);
+        EXPECT_NE(dec, nullptr);
+
+        EXPECT_EQ(dec->timestamp, 5678);
+        EXPECT_NE(dec->bundles, nullptr);
+        EXPECT_EQ(dec->bundles->timestamp, 9012);
+
+        EXPECT_NE(dec->messages, nullptr);
+        EXPECT_STREQ(dec->messages->addr, "/root/1");
+        EXPECT_STREQ(dec->messages->args[0].str, "test");
+        EXPECT_EQ(dec->messages->args[1].i32, 1234);
+
+        osc_arena_reset(arena);
+    }
+
+    // No heap traffic once the arena is set up
+    EXPECT_EQ(allocCount, allocs);
+
+    osc_free(data);
+    osc_arena_delete(arena);
+
+    EXPECT_EQ(allocCount, 0);
+}
+
+TEST(testArena, Grow)
+{
+    allocCount = 0;
+
+    OscArena* arena = osc_arena_create(64);
+
+    // Larger than a chunk
+    uint8_t* big = (uint8_t*)osc_arena_alloc(arena, 1000);
+    EXPECT_NE(big, nullptr);
+    memset(big, 0xAA, 1000);
+
+    OscMessage* msg = osc_message_create_ex(arena, "ifs");
+    EXPECT_NE(msg, nullptr);
+    EXPECT_STREQ(msg->tags, "ifs");
+    EXPECT_EQ(((uintptr_t)msg->args) & 7, 0);
+
+    msg->addr = osc_strdup_ex(arena, "/root");
+    msg->args[2].str = osc_strdup_ex(arena, "text");
+
+    uint8_t* data = NULL;
+    size_t   size = 0;
+    EXPECT_TRUE(osc_encode_message_ex(arena, msg, &data, &size) == 0);
+    EXPECT_EQ(size, 32);
+
+    // Chunks are reused after a reset
+    int32_t allocs = allocCount;
+    osc_arena_reset(arena);
+    EXPECT_NE(osc_arena_alloc(arena, 1000), nullptr);
+    EXPECT_EQ(allocCount, allocs);
+
+    osc_arena_delete(arena);
+
+    EXPECT_EQ(allocCount, 0);
+}
+
+// ============================================================================
+
+TEST(testNet, RecvBatch)
+{
+    allocCount = 0;
+
+    int fds[2];
+    EXPECT_EQ(socketpair(AF_UNIX, SOCK_DGRAM, 0, fds), 0);
+
+    uint8_t* ref = NULL;
+    size_t   size = 0;
+    EXPECT_TRUE(load_file("tests/assets/ref2.bin", &ref, &size) == 0);
+
+    // Two valid datagrams with garbage in between
+    const uint8_t garbage[] = {'x', 'y', 'z', 0};
+    EXPECT_EQ(send(fds[0], ref, size, 0), (ssize_t)size);
+    EXPECT_EQ(send(fds[0], garbage, sizeof(garbage), 0), (ssize_t)sizeof(garbage));
+    EXPECT_EQ(send(fds[0], ref, size, 0), (ssize_t)size);
+
+    OscNetRx* rx = osc_net_rx_create(fds[1], 8, 1500);
+    EXPECT_NE(rx, nullptr);
+
+    OscBundle* bundles[8];
+    EXPECT_EQ(osc_net_rx_recv(rx, NULL, bundles, 8, MSG_DONTWAIT), 3);
+
+    EXPECT_NE(bundles[0], nullptr);
+    EXPECT_EQ(bundles[1], nullptr);
+    EXPECT_NE(bundles[2], nullptr);
+
+    EXPECT_STREQ(bundles[0]->messages->addr, "/foo");
+    EXPECT_STREQ(bundles[2]->messages->tags, "iisff");
+
+    size_t len = 0;
+    EXPECT_EQ(memcmp(osc_net_rx_data(rx, 1, &len), garbage, sizeof(garbage)), 0);
+    EXPECT_EQ(len, sizeof(garbage));
+    EXPECT_NE(osc_net_rx_source(rx, 2), nullptr);
+    EXPECT_EQ(osc_net_rx_source(rx, 3), nullptr);
+
+    osc_bundle_delete(bundles[0]);
+    osc_bundle_delete(bundles[2]);
+
+    // Nothing pending
+    EXPECT_EQ(osc_net_rx_recv(rx, NULL, bundles, 8, MSG_DONTWAIT), -1);
+
+    // Blocking receive returns with fewer datagrams than asked for
+    EXPECT_EQ(send(fds[0], ref, size, 0), (ssize_t)size);
+    EXPECT_EQ(osc_net_rx_recv(rx, NULL, bundles, 8, 0), 1);
+    EXPECT_NE(bundles[0], nullptr);
+    osc_bundle_delete(bundles[0]);
+
+    osc_net_rx_delete(rx);
+
+    close(fds[0]);
+    close(fds[1]);
+    free(ref);
+
+    EXPECT_EQ(allocCount, 0);
+}
+
+static int udp_socket (OscNetAddr* addr) {
+
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+
+    struct sockaddr_in sin;
+    memset(&sin, 0, sizeof(sin));
+    sin.sin_family      = AF_INET;
+    sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    sin.sin_port        = 0;
+
+    bind(fd, (struct sockaddr*)&sin, sizeof(sin));
+
+    if (addr) {
+        addr->len = sizeof(addr->addr);
+        getsockname(fd, (struct sockaddr*)&addr->addr, &addr->len);
+    }
+
+    return fd;
+}
+
+TEST(testNet, SendFanOut)
+{
+    allocCount = 0;
+
+    OscNetAddr dests[2];
+    int rfd0 = udp_socket(&dests[0]);
+    int rfd1 = udp_socket(&dests[1]);
+    int sfd  = udp_socket(NULL);
+
+    OscMessage* msg = osc_message_create("f");
+    msg->addr = osc_strdup("/fader/1");
+    msg->args[0].f32 = 0.5f;
+
+    OscNetTx* tx = osc_net_tx_create(sfd, 4, 1500, 16);
+    EXPECT_NE(tx, nullptr);
+
+    // Flush on count
+    osc_net_tx_policy(tx, 4, 0);
+
+    int32_t allocs = allocCount;
+    EXPECT_EQ(osc_net_tx_queue_message(tx, msg, dests, 2), 0);
+    EXPECT_EQ(allocCount, allocs);
+
+    // Nothing sent yet
+    uint8_t buf[1500];
+    EXPECT_EQ(recv(rfd0, buf, sizeof(buf), MSG_DONTWAIT), -1);
+
+    EXPECT_EQ(osc_net_tx_queue_message(tx, msg, dests, 2), 0);
+
+    for (size_t i=0; i<2; ++i) {
+        int fd = i ? rfd1 : rfd0;
+        for (size_t j=0; j<2; ++j) {
+            ssize_t len = recv(fd, buf, sizeof(buf), MSG_DONTWAIT);
+            EXPECT_EQ(len, 20);
+
+            OscBundle* dec = osc_parse(buf, len);
+            EXPECT_NE(dec, nullptr);
+            EXPECT_STREQ(dec->messages->addr, "/fader/1");
+            EXPECT_FLOAT_EQ(dec->messages->args[0].f32, 0.5f);
+            osc_bundle_delete(dec);
+        }
+    }
+
+    // Flush on deadline
+    osc_net_tx_policy(tx, 0, 1000);
+
+    EXPECT_EQ(osc_net_tx_queue_message(tx, msg, dests, 1), 0);
+    usleep(1000);
+    EXPECT_EQ(osc_net_tx_poll(tx), 0);
+    EXPECT_EQ(recv(rfd0, buf, sizeof(buf), MSG_DONTWAIT), 20);
+
+    // Destinations are copied, the caller may reuse them before the flush
+    const uint8_t first[]  = {'/', 'a', 0, 0, ',', 0, 0, 0};
+    const uint8_t second[] = {'/', 'b', 0, 0, ',', 0, 0, 0};
+    osc_net_tx_policy(tx, 0, 0);
+
+    OscNetAddr target = dests[0];
+    EXPECT_EQ(osc_net_tx_queue(tx, first, sizeof(first), &target, 1), 0);
+    target = dests[1];
+    EXPECT_EQ(osc_net_tx_queue(tx, second, sizeof(second), &target, 1), 0);
+    memset((void*)&target, 0, sizeof(target));
+    EXPECT_EQ(osc_net_tx_flush(tx), 0);
+
+    EXPECT_EQ(recv(rfd0, buf, sizeof(buf), MSG_DONTWAIT), 8);
+    EXPECT_EQ(buf[1], 'a');
+    EXPECT_EQ(recv(rfd1, buf, sizeof(buf), MSG_DONTWAIT), 8);
+    EXPECT_EQ(buf[1], 'b');
+
+    // Oversize
+    EXPECT_EQ(osc_net_tx_queue(tx, buf, 2000, dests, 1), -1);
+    EXPECT_EQ(osc_net_tx_dropped(tx), 0u);
+
+    osc_net_tx_delete(tx);
+    osc_message_delete(msg);
+
+    close(rfd0);
+    close(rfd1);
+    close(sfd);
+
+    EXPECT_EQ(allocCount, 0);
+}
+
+// ============================================================================
+
+TEST(testDispatch, PatternMatch)
+{
+    EXPECT_TRUE (osc_pattern_match("/a/b", "/a/b"));
+    EXPECT_FALSE(osc_pattern_match("/a/b", "/a/bc"));
+    EXPECT_FALSE(osc_pattern_match("/a", "/a/b"));
+
+    EXPECT_TRUE (osc_pattern_match("/a/?", "/a/b"));
+    EXPECT_FALSE(osc_pattern_match("/a/?", "/a/bc"));
+
+    EXPECT_TRUE (osc_pattern_match("/a/*", "/a/bcd"));
+    EXPECT_TRUE (osc_pattern_match("/a/*d", "/a/bcd"));
+    EXPECT_TRUE (osc_pattern_match("/a/b*d*", "/a/bcd"));
+    EXPECT_FALSE(osc_pattern_match("/*", "/a/b"));
+
+    EXPECT_TRUE (osc_pattern_match("/ch/[1-3]", "/ch/2"));
+    EXPECT_FALSE(osc_pattern_match("/ch/[1-3]", "/ch/4"));
+    EXPECT_TRUE (osc_pattern_match("/ch/[!1-3]", "/ch/4"));
+    EXPECT_TRUE (osc_pattern_match("/ch/[abc]x", "/ch/bx"));
+
+    EXPECT_TRUE (osc_pattern_match("/{foo,bar}/x", "/bar/x"));
+    EXPECT_FALSE(osc_pattern_match("/{foo,bar}/x", "/baz/x"));
+    EXPECT_TRUE (osc_pattern_match("/{fo,foo}o", "/fooo"));
+
+    // Backtracking to the last star
+    EXPECT_TRUE (osc_pattern_match("/*a*b", "/xaxaxb"));
+    EXPECT_FALSE(osc_pattern_match("/*a*b", "/xaxbx"));
+    EXPECT_TRUE (osc_pattern_match("/*?", "/x"));
+    EXPECT_FALSE(osc_pattern_match("/*?", "/"));
+    EXPECT_TRUE (osc_pattern_match("/*[0-9]x", "/ab1x"));
+    EXPECT_TRUE (osc_pattern_match("/*{ab,b}c", "/xabc"));
+    EXPECT_FALSE(osc_pattern_match("/*{ab,b}c", "/xabd"));
+
+    // Star heavy patterns stay linear
+    char addr[160] = "/";
+    memset(&addr[1], 'a', 150);
+    addr[151] = 0;
+    EXPECT_FALSE(osc_pattern_match("/*a*a*a*a*a*ab", addr));
+    EXPECT_FALSE(osc_pattern_match("/*a*a*a*a*a*a*a*a*a*a*a*ab", addr));
+    EXPECT_TRUE (osc_pattern_match("/*a*a*a*a*a*a*a*a*a*a*a*a", addr));
+}
+
+static void count_method (const OscMessage* msg, int64_t timestamp, void* user) {
+    (void)msg;
+    (void)timestamp;
+    (*(int*)user)++;
+}
+
+TEST(testDispatch, Trie)
+{
+    allocCount = 0;
+
+    int c1 = 0, c2 = 0, c10 = 0, mute = 0;
+
+    OscDispatcher* disp = osc_dispatcher_create();
+    EXPECT_EQ(osc_dispatcher_add(disp, "/synth/1/freq", count_method, &c1), 0);
+    EXPECT_EQ(osc_dispatcher_add(disp, "/synth/2/freq", count_method, &c2), 0);
+    EXPECT_EQ(osc_dispatcher_add(disp, "/synth/10/gain", count_method, &c10), 0);
+    EXPECT_EQ(osc_dispatcher_add(disp, "/mixer/ch/mute", count_method, &mute), 0);
+
+    EXPECT_NE(osc_dispatcher_add(disp, "/synth/*/freq", count_method, &c1), 0);
+    EXPECT_NE(osc_dispatcher_add(disp, "synth", count_method, &c1), 0);
+
+    OscMessage* msg = osc_message_create("");
+
+    for (int compiled = 0; compiled < 2; ++compiled) {
+
+        if (compiled) {
+            osc_dispatcher_compile(disp);
+        }
+
+        const struct {
+            const char* pattern;
+            size_t      count;
+        } cases[] = {
+            {"/synth/1/freq",      1},
+            {"/synth/*/freq",      2},
+            {"/synth/[1-2]/freq",  2},
+            {"/synth/[!1]/freq",   1},
+            {"/synth/{1,10}/*",    2},
+            {"/synth/?/freq",      2},
+            {"/synth/*",           0},
+            {"/*/ch/mute",         1},
+            {"/nope",              0},
+        };
+
+        for (size_t i=0; i<sizeof(cases)/sizeof(cases[0]); ++i) {
+            msg->addr = (char*)cases[i].pattern;
+            EXPECT_EQ(osc_dispatch_message(disp, msg, OSC_IMMEDIATE), cases[i].count)
+                << cases[i].pattern;
+        }
+    }
+
+    msg->addr = NULL;
+    osc_message_delete(msg);
+
+    EXPECT_EQ(c1, 2 * 5);
+    EXPECT_EQ(c2, 2 * 4);
+    EXPECT_EQ(c10, 2 * 1);
+    EXPECT_EQ(mute, 2 * 1);
+
+    // Whole bundle tree
+    OscBundle* bundle = osc_bundle_create(OSC_IMMEDIATE);
+    OscBundle* inner  = osc_bundle_create(OSC_IMMEDIATE);
+
+    OscMessage* msg1 = osc_message_create("f");
+    msg1->addr = osc_strdup("/synth/*/freq");
+    OscMessage* msg2 = osc_message_create("T");
+    msg2->addr = osc_strdup("/mixer/ch/mute");
+
+    osc_bundle_add_message(bundle, msg1);
+    osc_bundle_add_message(inner, msg2);
+    osc_bundle_add_bundle(bundle, inner);
+
+    EXPECT_EQ(osc_dispatch_bundle(disp, bundle), 3);
+
+    osc_bundle_delete(bundle);
+    osc_dispatcher_delete(disp);
+
+    EXPECT_EQ(allocCount, 0);
+}
+
+// ============================================================================
+
+struct ScheduleLog {
+    size_t   count;
+    uint64_t last;
+    int      order;
+};
+
+static void schedule_method (const OscMessage* msg, int64_t timestamp, void* user) {
+    ScheduleLog* log = (ScheduleLog*)user;
+
+    // NTP time tags are unsigned
+    if ((uint64_t)timestamp < log->last) {
+        log->order = 0;
+    }
+
+    EXPECT_EQ(msg->args[0].i64, timestamp);
+
+    log->last = (uint64_t)timestamp;
+    log->count++;
+}
+
+static OscBundle* schedule_bundle (int64_t timestamp) {
+    OscMessage* msg = osc_message_create("t");
+    msg->addr = osc_strdup("/cue");
+    msg->args[0].i64 = timestamp;
+
+    OscBundle* bundle = osc_bundle_create(timestamp);
+    osc_bundle_add_message(bundle, msg);
+
+    return bundle;
+}
+
+TEST(testSchedule, Release)
+{
+    allocCount = 0;
+
+    const int64_t sec = 1LL << 32;
+    const int64_t t0  = (int64_t)(3900000000ULL << 32);
+
+    ScheduleLog log = {0, 0, 1};
+    OscScheduler* sched = osc_scheduler_create(schedule_method, &log, t0);
+    EXPECT_NE(sched, nullptr);
+
+    // Immediate
+    OscBundle* imm = schedule_bundle(OSC_IMMEDIATE);
+    imm->messages->args[0].i64 = OSC_IMMEDIATE;
+    osc_scheduler_add(sched, imm);
+
+    // Spread from sub-millisecond to days ahead
+    const int64_t offsets[] = {
+        sec / 8192, sec / 1000, sec / 2, sec, 10 * sec, 3600 * sec,
+        20 * 86400 * sec
+    };
+
+    for (size_t i=0; i<sizeof(offsets)/sizeof(offsets[0]); ++i) {
+        osc_scheduler_add(sched, schedule_bundle(t0 + offsets[i]));
+    }
+
+    // Nested bundle, the sub-bundle is due later
+    OscBundle* outer = schedule_bundle(t0 + 2 * sec);
+    osc_bundle_add_bundle(outer, schedule_bundle(t0 + 5 * sec));
+    osc_scheduler_add(sched, outer);
+
+    EXPECT_EQ(osc_scheduler_pending(sched), 10);
+
+    EXPECT_EQ(osc_scheduler_run(sched, t0), 1);
+
+    // Exact times within a tick are honored
+    EXPECT_EQ(osc_scheduler_run(sched, t0 + sec / 8192 - 1), 0);
+    EXPECT_EQ(osc_scheduler_run(sched, t0 + sec / 8192), 1);
+
+    EXPECT_EQ(osc_scheduler_run(sched, t0 + sec / 1000), 1);
+    EXPECT_EQ(osc_scheduler_run(sched, t0 + sec), 2);
+    EXPECT_EQ(osc_scheduler_run(sched, t0 + 4 * sec), 1);
+    EXPECT_EQ(osc_scheduler_run(sched, t0 + 9 * sec), 1);
+    EXPECT_EQ(osc_scheduler_run(sched, t0 + 3599 * sec), 1);
+    EXPECT_EQ(osc_scheduler_run(sched, t0 + 3600 * sec), 1);
+    EXPECT_EQ(osc_scheduler_run(sched, t0 + 10 * 86400 * sec), 0);
+
+    EXPECT_EQ(osc_scheduler_pending(sched), 1);
+    EXPECT_EQ(osc_scheduler_run(sched, t0 + 20 * 86400 * sec), 1);
+    EXPECT_EQ(osc_scheduler_pending(sched), 0);
+
+    EXPECT_EQ(log.count, 10);
+    EXPECT_EQ(log.order, 1);
+
+    // Pending bundles are freed with the scheduler
+    osc_scheduler_add(sched, schedule_bundle(t0 + 30 * 86400 * sec));
+    osc_scheduler_delete(sched);
+
+    EXPECT_EQ(allocCount, 0);
+}
+
+TEST(testSchedule, Many)
+{
+    allocCount = 0;
+
+    const int64_t sec = 1LL << 32;
+    const int64_t t0  = (int64_t)(3900000000ULL << 32);
+
+    ScheduleLog log = {0, 0, 1};
+    OscScheduler* sched = osc_scheduler_create(schedule_method, &log, t0);
+
+    const size_t count = 10000;
+    for (size_t i=0; i<count; ++i) {
+        int64_t ofs = ((int64_t)rand() << 16) % (60 * sec);
+        osc_scheduler_add(sched, schedule_bundle(t0 + ofs));
+    }
+
+    // Step in 1 ms increments, releases must not go back in time by more
+    // than one tick
+    size_t  released = 0;
+    int64_t step     = sec / 1000;
+    for (int64_t t = t0; t <= t0 + 61 * sec; t += step) {
+        log.last = 0;
+        released += osc_scheduler_run(sched, t);
+        EXPECT_LE(log.last, (uint64_t)t);
+    }
+
+    EXPECT_EQ(released, count);
+    EXPECT_EQ(osc_scheduler_pending(sched), 0);
+
+    osc_scheduler_delete(sched);
+
+    EXPECT_EQ(allocCount, 0);
+}
+
+TEST(testSchedule, TickOrder)
+{
+    allocCount = 0;
+
+    const int64_t sec = 1LL << 32;
+    const int64_t t0  = (int64_t)(3900000000ULL << 32);
+
+    // Same tick in the wheel and in the late list, added out of order
+    const int64_t bases[]   = {t0, t0 - sec};
+    const int64_t offsets[] = {300, 100, 200};
+
+    for (size_t b=0; b<2; ++b) {
+        for (int touch=0; touch<2; ++touch) {
+            ScheduleLog log = {0, 0, 1};
+            OscScheduler* sched = osc_scheduler_create(schedule_method, &log, t0);
+
+            for (size_t i=0; i<3; ++i) {
+                osc_scheduler_add(sched, schedule_bundle(bases[b] + offsets[i]));
+            }
+
+            // An earlier run over the slot does not change the order
+            if (touch) {
+                EXPECT_EQ(osc_scheduler_run(sched, bases[b] + 50), 0);
+            }
+
+            EXPECT_EQ(osc_scheduler_run(sched, t0 + 400), 3);
+            EXPECT_EQ(log.count, 3);
+            EXPECT_EQ(log.order, 1);
+
+            osc_scheduler_delete(sched);
+        }
+    }
+
+    EXPECT_EQ(allocCount, 0);
+}
+
+struct ScheduleChain {
+    OscScheduler*   sched;
+    int64_t         times[4];
+    size_t          count;
+};
+
+// Schedules a follow-up cue at the same time on the first call
+static void schedule_chain (const OscMessage* msg, int64_t timestamp, void* user) {
+    ScheduleChain* chain = (ScheduleChain*)user;
+    (void)msg;
+
+    if (chain->count == 0) {
+        osc_scheduler_add(chain->sched, schedule_bundle(timestamp));
+    }
+
+    chain->times[chain->count++] = timestamp;
+}
+
+TEST(testSchedule, AddFromMethod)
+{
+    allocCount = 0;
+
+    const int64_t sec = 1LL << 32;
+    const int64_t t0  = (int64_t)(3900000000ULL << 32);
+
+    ScheduleChain chain = {NULL, {0}, 0};
+    chain.sched = osc_scheduler_create(schedule_chain, &chain, t0);
+
+    // Wheel slot, then the late list
+    const int64_t times[] = {t0 + sec / 1000, t0 - sec};
+    for (size_t i=0; i<2; ++i) {
+        chain.count = 0;
+        osc_scheduler_add(chain.sched, schedule_bundle(times[i]));
+
+        EXPECT_EQ(osc_scheduler_run(chain.sched, t0 + sec / 1000), 1);
+        EXPECT_EQ(osc_scheduler_pending(chain.sched), 1);
+
+        EXPECT_EQ(osc_scheduler_run(chain.sched, t0 + sec / 1000), 1);
+        EXPECT_EQ(osc_scheduler_pending(chain.sched), 0);
+
+        EXPECT_EQ(chain.count, 2);
+        EXPECT_EQ(chain.times[1], times[i]);
+    }
+
+    osc_scheduler_delete(chain.sched);
+
+    EXPECT_EQ(allocCount, 0);
+}
+
+// ============================================================================
+
+TEST(testEncode, UnknownTag)
+{
+    allocCount = 0;
+
+    OscMessage* msg = osc_message_create("iX");
+    msg->addr = osc_strdup("/root");
+    EXPECT_EQ(msg->num_args, 2);
+
+    uint8_t* data = NULL;
+    size_t   size = 0;
+    EXPECT_NE(osc_encode_message(msg, &data, &size), 0);
+    EXPECT_EQ(data, nullptr);
+
+    OscBundle* bundle = osc_bundle_create(OSC_IMMEDIATE);
+    osc_bundle_add_message(bundle, msg);
+
+    EXPECT_NE(osc_encode_bundle(bundle, &data, &size), 0);
+    EXPECT_EQ(data, nullptr);
+
+    osc_bundle_delete(bundle);
+
+    EXPECT_EQ(allocCount, 0);
+}
+
+TEST(testEncode, WriterFailure)
+{
+    allocCount = 0;
+
+    // Larger than the encoder scratch, the invalid message is written last
+    OscBundle* bundle = osc_bundle_create(OSC_IMMEDIATE);
+
+    OscMessage* bad = osc_message_create("b");
+    bad->addr = osc_strdup("/bad");
+    bad->args[0].blob.size = -1;
+    osc_bundle_add_message(bundle, bad);
+
+    char text[200];
+    memset(text, 'x', sizeof(text) - 1);
+    text[sizeof(text) - 1] = 0;
+
+    for (int i=0; i<100; ++i) {
+        OscMessage* msg = osc_message_create("s");
+        msg->addr = osc_strdup("/text");
+        msg->args[0].str = osc_strdup(text);
+        osc_bundle_add_message(bundle, msg);
+    }
+
+    uint8_t* data = NULL;
+    size_t   size = 0;
+    EXPECT_EQ(osc_encode_bundle(bundle, &data, &size), -1);
+    EXPECT_EQ(data, nullptr);
+
+    OscArena* arena = osc_arena_create(1024);
+    EXPECT_EQ(osc_encode_bundle_ex(arena, bundle, &data, &size), -1);
+    EXPECT_EQ(data, nullptr);
+    osc_arena_delete(arena);
+
+    // Valid once the bad message is gone, encoded through the heap buffer
+    bad->args[0].blob.size = 0;
+    for (int i=0; i<2; ++i) {
+        data = NULL;
+        EXPECT_EQ(osc_encode_bundle(bundle, &data, &size), 0);
+        EXPECT_EQ(size, osc_bundle_encoded_size(bundle));
+        EXPECT_EQ(osc_validate(data, size, NULL), 0);
+        osc_free(data);
+    }
+
+    osc_bundle_delete(bundle);
+
+    EXPECT_EQ(allocCount, 0);
+}
+
+TEST(testEncode, Padding)
+{
+    allocCount = 0;
+
+    // String lengths around the 4 byte boundary
+    for (size_t len = 0; len < 9; ++len) {
+
+        char str[16] = {0};
+        memset(str, 'a', len);
+
+        OscMessage* msg = osc_message_create("s");
+        msg->addr = osc_strdup("/ab");
+        msg->args[0].str = osc_strdup(str);
+
+        uint8_t* data = NULL;
+        size_t   size = 0;
+        EXPECT_EQ(osc_encode_message(msg, &data, &size), 0);
+
+        size_t expected = 4 + 4 + ((len + 4) & ~3);
+        EXPECT_EQ(size, expected);
+
+        // Zero padding
+        for (size_t i = 8 + len; i < size; ++i) {
+            EXPECT_EQ(data[i], 0);
+        }
+
+        OscBundle* dec = osc_parse(data, size);
+        EXPECT_NE(dec, nullptr);
+        EXPECT_STREQ(dec->messages->args[0].str, str);
+
+        osc_bundle_delete(dec);
+        osc_free(data);
+        osc_message_delete(msg);
+    }
+
+    EXPECT_EQ(allocCount, 0);
+}
+
+TEST(testEncode, Into)
+{
+    allocCount = 0;
+
+    OscMessage* msg1 = osc_message_create("sihc");
+    msg1->addr = osc_strdup("/root/1");
+    msg1->args[0].str = osc_strdup("hello");
+    msg1->args[1].i32 = 1234;
+    msg1->args[2].i64 = -5678;
+    msg1->args[3].i32 = 'x';
+
+    OscMessage* msg2 = osc_message_create("d");
+    msg2->addr = osc_strdup("/root/2");
+    msg2->args[0].f64 = 1.2345;
+
+    OscBundle* bundle = osc_bundle_create(5678);
+    OscBundle* inner  = osc_bundle_create(9012);
+    osc_bundle_add_message(bundle, msg1);
+    osc_bundle_add_message(inner, msg2);
+    osc_bundle_add_bundle(bundle, inner);
+
+    // Message
+    uint8_t* ref  = NULL;
+    size_t   size = 0;
+    EXPECT_EQ(osc_encode_message(msg1, &ref, &size), 0);
+    EXPECT_EQ(osc_message_encoded_size(msg1), size);
+
+    uint8_t buf[256];
+    for (size_t cap = 0; cap < size; ++cap) {
+        size_t written = 0;
+        EXPECT_NE(osc_encode_message_into(msg1, buf, cap, &written), 0);
+        EXPECT_EQ(written, size);
+    }
+
+    size_t written = 0;
+    EXPECT_EQ(osc_encode_message_into(msg1, buf, sizeof(buf), &written), 0);
+    EXPECT_EQ(written, size);
+    EXPECT_EQ(memcmp(buf, ref, size), 0);
+    osc_free(ref);
+
+    // Bundle
+    ref = NULL;
+    EXPECT_EQ(osc_encode_bundle(bundle, &ref, &size), 0);
+    EXPECT_EQ(osc_bundle_encoded_size(bundle), size);
+
+    for (size_t cap = 0; cap < size; ++cap) {
+        written = 0;
+        EXPECT_NE(osc_encode_bundle_into(bundle, buf, cap, &written), 0);
+        EXPECT_EQ(written, size);
+    }
+
+    int32_t allocs = allocCount;
+    EXPECT_EQ(osc_encode_bundle_into(bundle, buf, size, &written), 0);
+    EXPECT_EQ(allocCount, allocs);
+    EXPECT_EQ(written, size);
+    EXPECT_EQ(memcmp(buf, ref, size), 0);
+    osc_free(ref);
+
+    // Invalid
+    OscMessage* bad = osc_message_create("X");
+    bad->addr = osc_strdup("/bad");
+    EXPECT_NE(osc_encode_message_into(bad, buf, sizeof(buf), &written), 0);
+    EXPECT_EQ(written, 0);
+    osc_message_delete(bad);
+
+    osc_bundle_delete(bundle);
+
+    EXPECT_EQ(allocCount, 0);
+}
+
+// ============================================================================
+
+TEST(testEncodeIov, Bundle)
+{
+    allocCount = 0;
+
+    // Long payload
+    char* wave = (char*)osc_malloc(4001);
+    for (size_t i=0; i<4000; ++i) {
+        wave[i] = 'a' + (i % 26);
+    }
+    wave[4000] = 0;
+
+    OscMessage* msg1 = osc_message_create("sfs");
+    msg1->addr = osc_strdup("/wave");
+    msg1->args[0].str = wave;
+    msg1->args[1].f32 = 0.25f;
+    msg1->args[2].str = osc_strdup("short");
+
+    OscMessage* msg2 = osc_message_create("i");
+    msg2->addr = osc_strdup("/n");
+    msg2->args[0].i32 = 7;
+
+    OscBundle* bundle = osc_bundle_create(5678);
+    OscBundle* inner  = osc_bundle_create(9012);
+    osc_bundle_add_message(bundle, msg1);
+    osc_bundle_add_message(inner, msg2);
+    osc_bundle_add_bundle(bundle, inner);
+
+    uint8_t* ref  = NULL;
+    size_t   size = 0;
+    EXPECT_EQ(osc_encode_bundle(bundle, &ref, &size), 0);
+
+    struct iovec iov[16];
+    uint8_t      scratch[256];
+    size_t       num_iov = 0;
+    size_t       total   = 0;
+
+    EXPECT_EQ(osc_encode_bundle_iov(bundle, iov, 16, &num_iov,
+                                    scratch, sizeof(scratch), &total), 0);
+    EXPECT_EQ(total, size);
+
+    // The long string is referenced, not copied
+    size_t refs = 0;
+    for (size_t i=0; i<num_iov; ++i) {
+        if (iov[i].iov_base == wave) {
+            EXPECT_EQ(iov[i].iov_len, 4000);
+            refs++;
+        }
+    }
+    EXPECT_EQ(refs, 1);
+    EXPECT_EQ(num_iov, 3);
+
+    // Gather and compare
+    uint8_t* flat = (uint8_t*)malloc(total);
+    size_t   ptr  = 0;
+    for (size_t i=0; i<num_iov; ++i) {
+        memcpy(&flat[ptr], iov[i].iov_base, iov[i].iov_len);
+        ptr += iov[i].iov_len;
+    }
+    EXPECT_EQ(memcmp(flat, ref, size), 0);
+    free(flat);
+
+    // Too small
+    EXPECT_NE(osc_encode_bundle_iov(bundle, iov, 2, &num_iov,
+                                    scratch, sizeof(scratch), &total), 0);
+    EXPECT_NE(osc_encode_bundle_iov(bundle, iov, 16, &num_iov,
+                                    scratch, 32, &total), 0);
+
+    // Message
+    EXPECT_EQ(osc_encode_message_iov(msg2, iov, 16, &num_iov,
+                                     scratch, sizeof(scratch), &total), 0);
+    EXPECT_EQ(num_iov, 1);
+    EXPECT_EQ(total, 12);
+
+    // Unbalanced arrays
+    const char* unbalanced[] = {"[i", "i]", "][", "[[i]"};
+    for (size_t i=0; i<4; ++i) {
+        OscMessage* bad = osc_message_create(unbalanced[i]);
+        bad->addr = osc_strdup("/bad");
+        EXPECT_NE(osc_encode_message_iov(bad, iov, 16, &num_iov,
+                                         scratch, sizeof(scratch), &total), 0);
+        osc_message_delete(bad);
+    }
+
+    osc_free(ref);
+    osc_bundle_delete(bundle);
+
+    EXPECT_EQ(allocCount, 0);
+}
+
+// ============================================================================
+
+struct StreamLog {
+    const uint8_t*  packets[4];
+    size_t          sizes[4];
+    size_t          count;
+    int             match;
+    const uint8_t*  chunk;
+    size_t          chunk_size;
+    size_t          inplace;
+};
+
+static void stream_handler (const uint8_t* data, size_t size, void* user) {
+    StreamLog* log = (StreamLog*)user;
+
+    size_t i = log->count++ % 4;
+    if (size != log->sizes[i] || memcmp(data, log->packets[i], size)) {
+        log->match = 0;
+    }
+
+    if (data >= log->chunk && data < log->chunk + log->chunk_size) {
+        log->inplace++;
+    }
+}
+
+TEST(testStream, Framing)
+{
+    allocCount = 0;
+
+    // Packets, one containing SLIP special bytes
+    OscMessage* msg = osc_message_create("ii");
+    msg->addr = osc_strdup("/slip");
+    msg->args[0].i32 = (int32_t)0xC0DBC0DB;
+    msg->args[1].i32 = (int32_t)0xDBDCDDC0;
+
+    uint8_t* pkt0 = NULL;
+    size_t   len0 = 0;
+    EXPECT_EQ(osc_encode_message(msg, &pkt0, &len0), 0);
+
+    uint8_t* pkt1 = NULL;
+    size_t   len1 = 0;
+    EXPECT_TRUE(load_file("tests/assets/ref2.bin", &pkt1, &len1) == 0);
+
+    StreamLog log;
+    memset(&log, 0, sizeof(log));
+    log.packets[0] = pkt0; log.sizes[0] = len0;
+    log.packets[1] = pkt1; log.sizes[1] = len1;
+    log.packets[2] = pkt0; log.sizes[2] = len0;
+    log.packets[3] = pkt1; log.sizes[3] = len1;
+
+    const int modes[] = {OSC_STREAM_LENGTH, OSC_STREAM_SLIP};
+    for (size_t m=0; m<2; ++m) {
+
+        // Encode the stream
+        uint8_t stream[512];
+        size_t  size = 0;
+        for (size_t i=0; i<4; ++i) {
+            size_t len = 0;
+            EXPECT_NE(osc_stream_encode(modes[m], log.packets[i], log.sizes[i],
+                                        stream, 3, &len), 0);
+            EXPECT_EQ(len, osc_stream_encoded_size(modes[m], log.packets[i], log.sizes[i]));
+
+            EXPECT_EQ(osc_stream_encode(modes[m], log.packets[i], log.sizes[i],
+                                        &stream[size], sizeof(stream) - size, &len), 0);
+            size += len;
+        }
+
+        OscStreamDecoder* dec = osc_stream_decoder_create(modes[m], 256);
+        EXPECT_NE(dec, nullptr);
+
+        // Whole stream at once, packets are passed in place
+        log.count      = 0;
+        log.match      = 1;
+        log.inplace    = 0;
+        log.chunk      = stream;
+        log.chunk_size = size;
+        EXPECT_EQ(osc_stream_decode(dec, stream, size, stream_handler, &log), 4);
+        EXPECT_EQ(log.match, 1);
+        if (modes[m] == OSC_STREAM_LENGTH) {
+            EXPECT_EQ(log.inplace, 4);
+        }
+        else {
+            EXPECT_EQ(log.inplace, 2);
+        }
+
+        // Every chunk size
+        for (size_t chunk = 1; chunk < size; ++chunk) {
+            log.count = 0;
+            log.match = 1;
+
+            for (size_t ptr = 0; ptr < size; ptr += chunk) {
+                size_t len = (size - ptr < chunk) ? size - ptr : chunk;
+                EXPECT_GE(osc_stream_decode(dec, &stream[ptr], len, stream_handler, &log), 0);
+            }
+
+            EXPECT_EQ(log.count, 4);
+            EXPECT_EQ(log.match, 1);
+        }
+
+        osc_stream_decoder_delete(dec);
+    }
+
+    // Oversize
+    OscStreamDecoder* dec = osc_stream_decoder_create(OSC_STREAM_LENGTH, 16);
+    const uint8_t big[] = {0, 0, 1, 0, '/', 'a', 0, 0};
+    EXPECT_EQ(osc_stream_decode(dec, big, sizeof(big), stream_handler, &log), -1);
+    osc_stream_decoder_delete(dec);
+
+    osc_free(pkt0);
+    free(pkt1);
+    osc_message_delete(msg);
+
+    EXPECT_EQ(allocCount, 0);
+}
+
+// ============================================================================
+
+TEST(testParsePacket, Flat)
+{
+    allocCount = 0;
+
+    // 3 levels, messages before and after sub-bundles
+    OscBundle* bundle = osc_bundle_create(1000);
+    OscBundle* inner1 = osc_bundle_create(2000);
+    OscBundle* inner2 = osc_bundle_create(3000);
+
+    for (int i=0; i<3; ++i) {
+        OscMessage* msg = osc_message_create("is");
+        msg->addr = osc_strdup("/top");
+        msg->args[0].i32 = i;
+        msg->args[1].str = osc_strdup("x");
+        osc_bundle_add_message(bundle, msg);
+    }
+
+    OscMessage* msg = osc_message_create("f");
+    msg->addr = osc_strdup("/inner1");
+    msg->args[0].f32 = 1.5f;
+    osc_bundle_add_message(inner1, msg);
+
+    msg = osc_message_create("");
+    msg->addr = osc_strdup("/inner2");
+    osc_bundle_add_message(inner2, msg);
+
+    osc_bundle_add_bundle(inner1, inner2);
+    osc_bundle_add_bundle(bundle, inner1);
+
+    uint8_t* data = NULL;
+    size_t   size = 0;
+    EXPECT_EQ(osc_encode_bundle(bundle, &data, &size), 0);
+    osc_bundle_delete(bundle);
+
+    int32_t allocs = allocCount;
+
+    OscPacket* packet = osc_parse_packet(data, size);
+    EXPECT_NE(packet, nullptr);
+    EXPECT_EQ(allocCount, allocs + 1);
+
+    // The source buffer is not referenced
+    memset(data, 0, size);
+    osc_free(data);
+
+    EXPECT_EQ(packet->num_bundles, 3);
+    EXPECT_EQ(packet->num_messages, 5);
+    EXPECT_EQ(packet->num_args, 7);
+
+    // Wire order, linked lists were built by prepending
+    EXPECT_EQ(packet->messages[0].args[0].i32, 2);
+    EXPECT_EQ(packet->messages[1].args[0].i32, 1);
+    EXPECT_EQ(packet->messages[2].args[0].i32, 0);
+    EXPECT_STREQ(packet->messages[2].args[1].str, "x");
+    EXPECT_STREQ(packet->messages[3].addr, "/inner1");
+    EXPECT_FLOAT_EQ(packet->messages[3].args[0].f32, 1.5f);
+    EXPECT_STREQ(packet->messages[4].addr, "/inner2");
+    EXPECT_STREQ(packet->messages[4].tags, "");
+
+    EXPECT_EQ(packet->bundles[0].timestamp, 1000);
+    EXPECT_EQ(packet->bundles[0].count, 5);
+    EXPECT_EQ(packet->bundles[1].timestamp, 2000);
+    EXPECT_EQ(packet->bundles[1].parent, 0);
+    EXPECT_EQ(packet->bundles[1].first, 3);
+    EXPECT_EQ(packet->bundles[1].count, 2);
+    EXPECT_EQ(packet->bundles[2].timestamp, 3000);
+    EXPECT_EQ(packet->bundles[2].parent, 1);
+    EXPECT_EQ(packet->bundles[2].first, 4);
+    EXPECT_EQ(packet->bundles[2].count, 1);
+
+    EXPECT_EQ(packet->messages[3].bundle, 1);
+    EXPECT_EQ(packet->messages[4].bundle, 2);
+
+    osc_packet_delete(packet);
+
+    // Invalid
+    const uint8_t bad[] = {'/', 'a', 0, 0, ',', 'i', 0, 0};
+    EXPECT_EQ(osc_parse_packet(bad, sizeof(bad)), nullptr);
+
+    EXPECT_EQ(allocCount, 0);
+}
+
+// ============================================================================
+
+TEST(testRoundtrip, Blob)
+{
+    allocCount = 0;
+
+    uint8_t payload[16];
+    for (size_t i=0; i<sizeof(payload); ++i) {
+        payload[i] = 0xF0 + i;
+    }
+
+    for (int32_t len = 0; len <= 9; ++len) {
+
+        OscMessage* msg = osc_message_create("bi");
+        msg->addr = osc_strdup("/blob");
+        msg->args[0].blob.data = payload;
+        msg->args[0].blob.size = len;
+        msg->args[1].i32 = 42;
+
+        uint8_t* data = NULL;
+        size_t   size = 0;
+        EXPECT_EQ(osc_encode_message(msg, &data, &size), 0);
+        EXPECT_EQ(size, 8 + 4 + 4 + ((len + 3) & ~3) + 4);
+        EXPECT_EQ(size & 3, 0);
+
+        // Parsed blobs point into the buffer
+        OscBundle* dec = osc_parse(data, size);
+        EXPECT_NE(dec, nullptr);
+
+        OscMessage* res = dec->messages;
+        EXPECT_STREQ(res->tags, "bi");
+        EXPECT_EQ(res->args[0].blob.size, len);
+        EXPECT_EQ(res->args[0].blob.data, data + 16);
+        EXPECT_EQ(memcmp(res->args[0].blob.data, payload, len), 0);
+        EXPECT_EQ(res->args[1].i32, 42);
+
+        OscView view;
+        EXPECT_EQ(osc_parse_view(data, size, &view), 0);
+        EXPECT_EQ(view.messages[0].args[0].blob.size, len);
+        EXPECT_EQ(view.messages[0].args[1].i32, 42);
+
+        // Truncated blob
+        if (len) {
+            EXPECT_EQ(osc_parse(data, 16 + len - 1), nullptr);
+        }
+
+        osc_bundle_delete(dec);
+        osc_free(data);
+        osc_message_delete(msg);
+    }
+
+    EXPECT_EQ(allocCount, 0);
+}
+
+TEST(testRoundtrip, BlobCopy)
+{
+    allocCount = 0;
+
+    OscMessage* msg = osc_message_create("bsb");
+    msg->addr = osc_strdup("/blob");
+    msg->args[0].blob.data = (const uint8_t*)"first";
+    msg->args[0].blob.size = 5;
+    msg->args[1].str = osc_strdup("text");
+    msg->args[2].blob.data = (const uint8_t*)"second blob";
+    msg->args[2].blob.size = 11;
+
+    OscBundle* bundle = osc_bundle_create(OSC_IMMEDIATE);
+    OscBundle* inner  = osc_bundle_create(OSC_IMMEDIATE);
+    osc_bundle_add_message(inner, msg);
+    osc_bundle_add_bundle(bundle, inner);
+
+    uint8_t* data = NULL;
+    size_t   size = 0;
+    EXPECT_EQ(osc_encode_bundle(bundle, &data, &size), 0);
+
+    // Copies outlive the source buffer
+    OscArena*  arena = osc_arena_create(256);
+    OscBundle* heap  = osc_parse_result(NULL, data, size, OSC_PARSE_COPY_BLOBS, NULL);
+    OscBundle* owned = osc_parse_result(arena, data, size,
+                                        OSC_PARSE_STRICT | OSC_PARSE_COPY_BLOBS, NULL);
+    ASSERT_NE(heap, nullptr);
+    ASSERT_NE(owned, nullptr);
+    memset(data, 0, size);
+
+    const OscBundle* trees[] = {heap, owned};
+    for (const OscBundle* tree : trees) {
+        const OscMessage* res = tree->bundles->messages;
+        EXPECT_EQ(res->args[0].blob.size, 5);
+        EXPECT_EQ(memcmp(res->args[0].blob.data, "first", 5), 0);
+        EXPECT_STREQ(res->args[1].str, "text");
+        EXPECT_EQ(res->args[2].blob.size, 11);
+        EXPECT_EQ(memcmp(res->args[2].blob.data, "second blob", 11), 0);
+    }
+
+    osc_bundle_delete(heap);
+    osc_arena_delete(arena);
+    osc_free(data);
+    osc_bundle_delete(bundle);
+
+    EXPECT_EQ(allocCount, 0);
+}
+
+TEST(testEncodeIov, Blob)
+{
+    allocCount = 0;
+
+    uint8_t frame[1021];
+    for (size_t i=0; i<sizeof(frame); ++i) {
+        frame[i] = i & 0xFF;
+    }
+
+    OscMessage* msg = osc_message_create("bb");
+    msg->addr = osc_strdup("/cam/thumb");
+    msg->args[0].blob.data = frame;
+    msg->args[0].blob.size = sizeof(frame);
+    msg->args[1].blob.data = frame;
+    msg->args[1].blob.size = 3;
+
+    uint8_t* ref  = NULL;
+    size_t   size = 0;
+    EXPECT_EQ(osc_encode_message(msg, &ref, &size), 0);
+
+    struct iovec iov[8];
+    uint8_t      scratch[64];
+    size_t       num_iov = 0;
+    size_t       total   = 0;
+
+    EXPECT_EQ(osc_encode_message_iov(msg, iov, 8, &num_iov,
+                                     scratch, sizeof(scratch), &total), 0);
+    EXPECT_EQ(total, size);
+    EXPECT_EQ(num_iov, 3);
+    EXPECT_EQ(iov[1].iov_base, frame);
+
+    size_t ptr = 0;
+    for (size_t i=0; i<num_iov; ++i) {
+        EXPECT_EQ(memcmp(ref + ptr, iov[i].iov_base, iov[i].iov_len), 0);
+        ptr += iov[i].iov_len;
+    }
+
+    osc_free(ref);
+    osc_message_delete(msg);
+
+    EXPECT_EQ(allocCount, 0);
+}
+
+// ============================================================================
+
+TEST(testRoundtrip, Array)
+{
+    allocCount = 0;
+
+    const char* tags[] = {"i[ff]", "[[i]s[]]", "c[hdt]mr", "[if"};
+    const int   valid[] = {1, 1, 1, 0};
+
+    for (size_t n=0; n<4; ++n) {
+
+        OscMessage* msg = osc_message_create(tags[n]);
+        msg->addr = osc_strdup("/array");
+
+        for (size_t i=0; i<msg->num_args; ++i) {
+            switch (msg->tags[i]) {
+                case 's': msg->args[i].str = osc_strdup("str"); break;
+                case 'c': msg->args[i].i32 = 'q';               break;
+                default:  msg->args[i].i64 = 0x0102030405060708LL * (i + 1);
+            }
+        }
+
+        uint8_t* data = NULL;
+        size_t   size = 0;
+        int      res  = osc_encode_message(msg, &data, &size);
+
+        if (!valid[n]) {
+            EXPECT_NE(res, 0);
+            osc_message_delete(msg);
+            continue;
+        }
+
+        EXPECT_EQ(res, 0);
+
+        // Both the owning and the view parser, repeatedly to hit the plan
+        // cache
+        for (int k=0; k<2; ++k) {
+            OscBundle* dec = osc_parse(data, size);
+            EXPECT_NE(dec, nullptr);
+
+            OscView view;
+            EXPECT_EQ(osc_parse_view(data, size, &view), 0);
+
+            const OscArgument* args[] = {dec->messages->args, view.messages[0].args};
+            for (size_t v=0; v<2; ++v) {
+                for (size_t i=0; i<msg->num_args; ++i) {
+                    switch (msg->tags[i]) {
+                        case 'i': case 'f': case 'm': case 'r':
+                            EXPECT_EQ(args[v][i].i32, msg->args[i].i32);
+                            break;
+                        case 'h': case 'd': case 't':
+                            EXPECT_EQ(args[v][i].i64, msg->args[i].i64);
+                            break;
+                        case 'c':
+                            EXPECT_EQ(args[v][i].i32, 'q');
+                            break;
+                        case 's':
+                            EXPECT_STREQ(args[v][i].str, "str");
+                            break;
+                        case '[': case ']':
+                            EXPECT_EQ(args[v][i].i32, 0);
+                            break;
+                    }
+                }
+            }
+
+            osc_bundle_delete(dec);
+        }
+
+        // Truncated
+        EXPECT_EQ(osc_parse(data, size - 4), nullptr);
+
+        osc_free(data);
+        osc_message_delete(msg);
+    }
+
+    // Unbalanced on the wire
+    const uint8_t bad[] = {'/', 'a', 0, 0, ',', 'i', ']', 0, 0, 0, 0, 1};
+    EXPECT_EQ(osc_parse(bad, sizeof(bad)), nullptr);
+
+    EXPECT_EQ(allocCount, 0);
+}
+
+// ============================================================================
+
+static constexpr char kFader[] = "/fader/12";
+static constexpr char kMixed[] = "/mixed";
+
+TEST(testCodec, Fixed)
+{
+    allocCount = 0;
+
+    typedef osc::Codec<kFader, 'f'> Fader;
+    static_assert(Fader::size == 12 + 4 + 4, "size");
+
+    typedef osc::Codec<kMixed, 'i', 'h', 'T', 'd', 'c'> Mixed;
+    static_assert(Mixed::size == 8 + 8 + 4 + 8 + 8 + 4, "size");
+
+    // Codec -> library
+    uint8_t buf[64];
+    EXPECT_EQ(Fader::encode(buf, 4, 0.75f), 0);
+    EXPECT_EQ(Fader::encode(buf, sizeof(buf), 0.75f), Fader::size);
+
+    OscBundle* dec = osc_parse(buf, Fader::size);
+    EXPECT_NE(dec, nullptr);
+    EXPECT_STREQ(dec->messages->addr, "/fader/12");
+    EXPECT_STREQ(dec->messages->tags, "f");
+    EXPECT_FLOAT_EQ(dec->messages->args[0].f32, 0.75f);
+    osc_bundle_delete(dec);
+
+    // Library -> codec
+    OscMessage* msg = osc_message_create("ihTdc");
+    msg->addr = osc_strdup("/mixed");
+    msg->args[0].i32 = -7;
+    msg->args[1].i64 = 0x123456789ALL;
+    msg->args[3].f64 = 2.5;
+    msg->args[4].i32 = 'z';
+
+    uint8_t* data = NULL;
+    size_t   size = 0;
+    EXPECT_EQ(osc_encode_message(msg, &data, &size), 0);
+    EXPECT_EQ(size, Mixed::size);
+
+    int32_t    i = 0;
+    int64_t    h = 0;
+    osc::Empty t;
+    double     d = 0;
+    char       c = 0;
+    EXPECT_TRUE(Mixed::decode(data, size, i, h, t, d, c));
+    EXPECT_EQ(i, -7);
+    EXPECT_EQ(h, 0x123456789ALL);
+    EXPECT_DOUBLE_EQ(d, 2.5);
+    EXPECT_EQ(c, 'z');
+
+    EXPECT_EQ(Mixed::encode(buf, sizeof(buf), i, h, t, d, c), size);
+    EXPECT_EQ(memcmp(buf, data, size), 0);
+
+    // Other address / signature
+    float f = 0;
+    EXPECT_FALSE(Fader::decode(data, size, f));
+    EXPECT_FALSE(Mixed::decode(data, size - 1, i, h, t, d, c));
+
+    // Trailing bytes
+    uint8_t padded[Mixed::size + 4] = {};
+    memcpy(padded, data, size);
+    EXPECT_FALSE(Mixed::decode(padded, sizeof(padded), i, h, t, d, c));
+
+    osc_free(data);
+    osc_message_delete(msg);
+
+    EXPECT_EQ(allocCount, 0);
+}
+
+// ============================================================================
+
+TEST(testTemplate, Bundle)
+{
+    allocCount = 0;
+
+    OscMessage* msg1 = osc_message_create("sfc");
+    msg1->addr = osc_strdup("/mix/ch/1");
+    msg1->args[0].str = osc_strdup("gain");
+    msg1->args[1].f32 = 0.5f;
+    msg1->args[2].i32 = 'a';
+
+    OscMessage* msg2 = osc_message_create("Tid");
+    msg2->addr = osc_strdup("/mix/ch/2");
+    msg2->args[1].i32 = 1;
+    msg2->args[2].f64 = 1.5;
+
+    OscBundle* bundle = osc_bundle_create(1000);
+    OscBundle* inner  = osc_bundle_create(2000);
+    osc_bundle_add_message(bundle, msg1);
+    osc_bundle_add_message(inner, msg2);
+    osc_bundle_add_bundle(bundle, inner);
+
+    OscTemplate* tpl = osc_template_bundle(bundle);
+    EXPECT_NE(tpl, nullptr);
+
+    // Patch in place
+    EXPECT_EQ(osc_template_set_f32(tpl, 1, -0.25f), 0);
+    EXPECT_EQ(osc_template_set_i32(tpl, 2, 'z'), 0);
+    EXPECT_EQ(osc_template_set_i32(tpl, 4, 42), 0);
+    EXPECT_EQ(osc_template_set_f64(tpl, 5, 3.75), 0);
+    EXPECT_EQ(osc_template_set_timestamp(tpl, 0, 1111), 0);
+    EXPECT_EQ(osc_template_set_timestamp(tpl, 1, 2222), 0);
+
+    // Type and range checks
+    EXPECT_EQ(osc_template_set_i32(tpl, 0, 1), -1);
+    EXPECT_EQ(osc_template_set_f32(tpl, 3, 1.0f), -1);
+    EXPECT_EQ(osc_template_set_i64(tpl, 5, 1), -1);
+    EXPECT_EQ(osc_template_set_i32(tpl, 6, 1), -1);
+    EXPECT_EQ(osc_template_set_timestamp(tpl, 2, 1), -1);
+
+    // Same bytes as encoding the updated bundle
+    msg1->args[1].f32 = -0.25f;
+    msg1->args[2].i32 = 'z';
+    msg2->args[1].i32 = 42;
+    msg2->args[2].f64 = 3.75;
+    bundle->timestamp = 1111;
+    inner->timestamp  = 2222;
+
+    uint8_t* data = NULL;
+    size_t   size = 0;
+    EXPECT_EQ(osc_encode_bundle(bundle, &data, &size), 0);
+
+    size_t         tpl_size = 0;
+    const uint8_t* tpl_data = osc_template_data(tpl, &tpl_size);
+    EXPECT_EQ(tpl_size, size);
+    EXPECT_EQ(memcmp(tpl_data, data, size), 0);
+
+    osc_free(data);
+    osc_template_delete(tpl);
+
+    // Message
+    tpl = osc_template_message(msg2);
+    EXPECT_NE(tpl, nullptr);
+    EXPECT_EQ(osc_template_set_timestamp(tpl, 0, 1), -1);
+    EXPECT_EQ(osc_template_set_i32(tpl, 1, -9), 0);
+
+    OscBundle* dec = osc_parse(osc_template_data(tpl, &tpl_size), tpl_size);
+    EXPECT_NE(dec, nullptr);
+    EXPECT_EQ(dec->messages->args[1].i32, -9);
+    EXPECT_DOUBLE_EQ(dec->messages->args[2].f64, 3.75);
+    osc_bundle_delete(dec);
+
+    osc_template_delete(tpl);
+    osc_bundle_delete(bundle);
+
+    EXPECT_EQ(allocCount, 0);
+}
+
+// ============================================================================
+
+TEST(testSimd, Scan)
+{
+    uint8_t buf[100];
+    memset(buf, 'x', sizeof(buf));
+
+    for (int level=OSC_SIMD_AVX2; level>=OSC_SIMD_SCALAR; --level) {
+        osc_simd_set_level(level);
+
+        for (size_t start=0; start<8; ++start) {
+            for (size_t pos=start; pos<sizeof(buf); ++pos) {
+                buf[pos] = 0;
+                EXPECT_EQ(osc_simd_scan(buf, sizeof(buf), start), pos + 1);
+                EXPECT_EQ(osc_simd_scan(buf, pos, start), 0);
+                buf[pos] = 'x';
+            }
+        }
+    }
+
+    osc_simd_set_level(OSC_SIMD_AVX2);
+}
+
+TEST(testSimd, NumericRuns)
+{
+    allocCount = 0;
+
+    // Float array beyond the plan size, numeric runs around strings
+    std::string tags(515, 'f');
+    tags += "shhhhhdsiiiiiii";
+
+    OscMessage* msg = osc_message_create(tags.c_str());
+    msg->addr = osc_strdup("/dmx/universe/1/with/a/rather/long/address");
+    for (size_t i=0; i<515; ++i) {
+        msg->args[i].f32 = (float)i / 512.0f;
+    }
+    msg->args[515].str = osc_strdup("a string longer than thirty two bytes");
+    for (size_t i=516; i<521; ++i) {
+        msg->args[i].i64 = -(int64_t)i * 0x100000001LL;
+    }
+    msg->args[521].f64 = -0.125;
+    msg->args[522].str = osc_strdup("");
+    for (size_t i=523; i<530; ++i) {
+        msg->args[i].i32 = (int32_t)(i * 0x01020304);
+    }
+
+    uint8_t* data = NULL;
+    size_t   size = 0;
+    EXPECT_EQ(osc_encode_message(msg, &data, &size), 0);
+
+    for (int level=OSC_SIMD_AVX2; level>=OSC_SIMD_SCALAR; --level) {
+        osc_simd_set_level(level);
+        SCOPED_TRACE(level);
+
+        OscBundle* dec = osc_parse(data, size);
+        EXPECT_NE(dec, nullptr);
+
+        const OscMessage* mss = dec->messages;
+        EXPECT_STREQ(mss->addr, msg->addr);
+        EXPECT_STREQ(mss->tags, msg->tags);
+        for (size_t i=0; i<msg->num_args; ++i) {
+            switch (msg->tags[i]) {
+                case 's': EXPECT_STREQ(mss->args[i].str, msg->args[i].str); break;
+                case 'f':
+                case 'i': EXPECT_EQ(mss->args[i].i32, msg->args[i].i32);    break;
+                default:  EXPECT_EQ(mss->args[i].i64, msg->args[i].i64);    break;
+            }
+        }
+        osc_bundle_delete(dec);
+
+        // Truncated inside a run
+        EXPECT_EQ(osc_parse(data, 515 * 4), nullptr);
+        EXPECT_EQ(osc_parse(data, size - 4), nullptr);
+    }
+
+    osc_simd_set_level(OSC_SIMD_AVX2);
+
+    osc_free(data);
+    osc_message_delete(msg);
+
+    EXPECT_EQ(allocCount, 0);
+}
+
+// ============================================================================
+
+TEST(testValidate, Packets)
+{
+    allocCount = 0;
+
+    OscMessage* msg1 = osc_message_create("sbi");
+    msg1->addr = osc_strdup("/first");
+    msg1->args[0].str = osc_strdup("text");
+    msg1->args[1].blob.data = (const uint8_t*)"blob";
+    msg1->args[1].blob.size = 4;
+    msg1->args[2].i32 = 7;
+
+    OscMessage* msg2 = osc_message_create("[ff]");
+    msg2->addr = osc_strdup("/second");
+
+    OscBundle* bundle = osc_bundle_create(1234);
+    OscBundle* inner  = osc_bundle_create(5678);
+    OscBundle* deeper = osc_bundle_create(9012);
+    osc_bundle_add_message(bundle, msg1);
+    osc_bundle_add_message(deeper, msg2);
+    osc_bundle_add_bundle(inner, deeper);
+    osc_bundle_add_bundle(bundle, inner);
+
+    uint8_t* data = NULL;
+    size_t   size = 0;
+    EXPECT_EQ(osc_encode_bundle(bundle, &data, &size), 0);
+
+    int32_t allocs = allocCount;
+
+    OscInfo info;
+    EXPECT_EQ(osc_validate(data, size, &info), 0);
+    EXPECT_EQ(allocCount, allocs);
+    EXPECT_EQ(info.num_bundles, 3);
+    EXPECT_EQ(info.num_messages, 2);
+    EXPECT_EQ(info.num_args, 7);
+    EXPECT_EQ(info.depth, 3);
+    EXPECT_STREQ(info.addr, "/first");
+
+    // Element size past the end
+    uint8_t* copy = (uint8_t*)osc_malloc(size);
+    memcpy(copy, data, size);
+    copy[19] = 0xFF;
+    EXPECT_EQ(osc_validate(copy, size, &info), -1);
+    osc_free(copy);
+    osc_free(data);
+
+    // Bare message with an unbalanced array
+    data = NULL;
+    EXPECT_EQ(osc_encode_message(msg1, &data, &size), 0);
+    EXPECT_EQ(osc_validate(data, size, NULL), 0);
+    EXPECT_EQ(osc_validate(data, size, &info), 0);
+    EXPECT_EQ(info.num_bundles, 0);
+    EXPECT_EQ(info.num_messages, 1);
+    EXPECT_EQ(info.depth, 0);
+    EXPECT_STREQ(info.addr, "/first");
+
+    EXPECT_EQ(osc_validate(data, size - 4, &info), -1);
+
+    data[9] = '[';    // ",sbi" -> ",[bi"
+    EXPECT_EQ(osc_validate(data, size, &info), -1);
+    osc_free(data);
+
+    osc_bundle_delete(bundle);
+
+    EXPECT_EQ(allocCount, 0);
+}
+
+// ============================================================================
+
+TEST(testRouter, Rules)
+{
+    allocCount = 0;
+
+    char mixer[] = "/mixer";
+    char light[] = "/light=/dmx";
+    char any[]   = "/";
+    char glob[]  = "/mix*/";
+
+    RouterTable table;
+    memset(&table, 0, sizeof(table));
+    EXPECT_EQ(router_table_add(&table, mixer, 0), 0);
+    EXPECT_EQ(router_table_add(&table, light, 1), 0);
+    EXPECT_EQ(router_table_add(&table, any, 2), 0);
+    EXPECT_EQ(router_table_add(&table, glob, 3), 0);
+
+    char bad[] = "mixer";
+    EXPECT_EQ(router_table_add(&table, bad, 0), -1);
+
+    // Leading segments only
+    EXPECT_EQ(router_rule_match(&table.rules[0], "/mixer/1"), 6);
+    EXPECT_EQ(router_rule_match(&table.rules[0], "/mixers/1"), -1);
+    EXPECT_EQ(router_rule_match(&table.rules[2], "/anything"), 0);
+    EXPECT_EQ(router_rule_match(&table.rules[3], "/mixdown"), 8);
+    EXPECT_STREQ(table.rules[3].pattern, "/mix*");
+
+    OscMessage* msg1 = osc_message_create("i");
+    msg1->addr = osc_strdup("/mixer/1");
+    OscMessage* msg2 = osc_message_create("f");
+    msg2->addr = osc_strdup("/mixer/2");
+
+    OscBundle* bundle = osc_bundle_create(1234);
+    osc_bundle_add_message(bundle, msg1);
+    osc_bundle_add_message(bundle, msg2);
+
+    uint8_t* data = NULL;
+    size_t   size = 0;
+    EXPECT_EQ(osc_encode_bundle(bundle, &data, &size), 0);
+
+    // Every message goes to the mixer unchanged: original bytes
+    uint64_t forward = 0;
+    uint64_t rebuild = 0;
+    EXPECT_EQ(router_table_route(&table, data, size, &forward, &rebuild), 0);
+    EXPECT_EQ(forward, 0x0DULL);
+    EXPECT_EQ(rebuild, 0ULL);
+
+    uint8_t out[256];
+    EXPECT_EQ(router_table_build(&table, 0, data, size, out, sizeof(out)), size);
+    EXPECT_EQ(memcmp(out, data, size), 0);
+    osc_free(data);
+
+    // A light message is rewritten, the mixer gets its own part
+    osc_free(msg2->addr);
+    msg2->addr = osc_strdup("/light/3");
+
+    data = NULL;
+    EXPECT_EQ(osc_encode_bundle(bundle, &data, &size), 0);
+    EXPECT_EQ(router_table_route(&table, data, size, &forward, &rebuild), 0);
+    EXPECT_EQ(forward, 0x04ULL);
+    EXPECT_EQ(rebuild, 0x0BULL);
+
+    size_t len = router_table_build(&table, 1, data, size, out, sizeof(out));
+    OscBundle* parsed = osc_parse(out, len);
+    ASSERT_NE(parsed, nullptr);
+    EXPECT_EQ(parsed->timestamp, 1234);
+    ASSERT_NE(parsed->messages, nullptr);
+    EXPECT_STREQ(parsed->messages->addr, "/dmx/3");
+    EXPECT_EQ(parsed->messages->next, nullptr);
+    osc_bundle_delete(parsed);
+
+    len = router_table_build(&table, 0, data, size, out, sizeof(out));
+    parsed = osc_parse(out, len);
+    ASSERT_NE(parsed, nullptr);
+    ASSERT_NE(parsed->messages, nullptr);
+    EXPECT_STREQ(parsed->messages->addr, "/mixer/1");
+    EXPECT_EQ(parsed->messages->next, nullptr);
+    osc_bundle_delete(parsed);
+
+    // Too small and malformed
+    EXPECT_EQ(router_table_build(&table, 1, data, size, out, 20), 0);
+    EXPECT_EQ(router_table_route(&table, data, size - 1, &forward, &rebuild), -1);
+    EXPECT_EQ(forward | rebuild, 0ULL);
+
+    osc_free(data);
+    osc_bundle_delete(bundle);
+
+    EXPECT_EQ(allocCount, 0);
+}
+
+// ============================================================================
+
+TEST(testParseResult, Faults)
+{
+    allocCount = 0;
+
+    // Bundle {"/a" i, bundle {"/b" f}}
+    uint8_t packet[] = {
+        '#', 'b', 'u', 'n', 'd', 'l', 'e', 0,   0, 0, 0, 0, 0, 0, 0, 1,
+        0, 0, 0, 12,  '/', 'a', 0, 0,  ',', 'i', 0, 0,  0, 0, 0, 7,
+        0, 0, 0, 32,
+        '#', 'b', 'u', 'n', 'd', 'l', 'e', 0,   0, 0, 0, 0, 0, 0, 0, 2,
+        0, 0, 0, 12,  '/', 'b', 0, 0,  ',', 'f', 0, 0,  0x3F, 0x80, 0, 0,
+    };
+
+    OscParseResult res;
+    OscInfo        info;
+
+    OscBundle* bundle = osc_parse_result(NULL, packet, sizeof(packet), OSC_PARSE_STRICT, &res);
+    EXPECT_NE(bundle, nullptr);
+    EXPECT_EQ(res.error, OSC_ERR_NONE);
+    EXPECT_EQ(res.arg, -1);
+    osc_bundle_delete(bundle);
+
+    // Unknown tag in the nested message
+    uint8_t copy[sizeof(packet)];
+    memcpy(copy, packet, sizeof(packet));
+    copy[61] = 'x';
+    EXPECT_EQ(osc_validate_result(copy, sizeof(copy), OSC_PARSE_LENIENT, &info, &res), -1);
+    EXPECT_EQ(res.error, OSC_ERR_ARGUMENT);
+    EXPECT_EQ(res.offset, 64);
+    EXPECT_EQ(res.arg, 0);
+    EXPECT_EQ(res.depth, 2);
+    EXPECT_EQ(res.path[0], 1);
+    EXPECT_EQ(res.path[1], 0);
+
+    // Truncated argument, found after the parser rejected the packet
+    copy[61] = 'd';
+    EXPECT_EQ(osc_parse_result(NULL, copy, sizeof(copy), OSC_PARSE_LENIENT, &res), nullptr);
+    EXPECT_EQ(res.error, OSC_ERR_ARGUMENT);
+    EXPECT_EQ(res.offset, 64);
+    EXPECT_EQ(res.arg, 0);
+    EXPECT_EQ(res.depth, 2);
+
+    // Element size past the end
+    memcpy(copy, packet, sizeof(packet));
+    copy[35] = 0xFF;
+    EXPECT_EQ(osc_validate_result(copy, sizeof(copy), OSC_PARSE_LENIENT, NULL, &res), -1);
+    EXPECT_EQ(res.error, OSC_ERR_BUNDLE);
+    EXPECT_EQ(res.offset, 32);
+    EXPECT_EQ(res.depth, 1);
+    EXPECT_EQ(res.path[0], 1);
+
+    // Bare message
+    memcpy(copy, packet, sizeof(packet));
+    copy[20] = 'x';
+    EXPECT_EQ(osc_validate_result(&copy[20], 12, OSC_PARSE_LENIENT, NULL, &res), -1);
+    EXPECT_EQ(res.error, OSC_ERR_ADDRESS);
+    EXPECT_EQ(res.offset, 0);
+    EXPECT_EQ(res.depth, 0);
+
+    // Trailing bytes are only rejected in strict mode
+    uint8_t message[16] = {'/', 'a', 0, 0,  ',', 'i', 0, 0,  0, 0, 0, 7,  0, 0, 0, 0};
+    EXPECT_EQ(osc_validate_result(message, 16, OSC_PARSE_LENIENT, NULL, &res), 0);
+    EXPECT_EQ(osc_parse_result(NULL, message, 16, OSC_PARSE_STRICT, &res), nullptr);
+    EXPECT_EQ(res.error, OSC_ERR_SIZE);
+    EXPECT_EQ(res.offset, 12);
+
+    // Unaligned element size
+    uint8_t unaligned[] = {
+        '#', 'b', 'u', 'n', 'd', 'l', 'e', 0,   0, 0, 0, 0, 0, 0, 0, 1,
+        0, 0, 0, 13,  '/', 'a', 0, 0,  ',', 'i', 0, 0,  0, 0, 0, 7,  0,
+    };
+
+    bundle = osc_parse_result(NULL, unaligned, sizeof(unaligned), OSC_PARSE_LENIENT, &res);
+    EXPECT_NE(bundle, nullptr);
+    osc_bundle_delete(bundle);
+
+    EXPECT_EQ(osc_validate_result(unaligned, sizeof(unaligned), OSC_PARSE_STRICT, NULL, &res), -1);
+    EXPECT_EQ(res.error, OSC_ERR_SIZE);
+    EXPECT_EQ(res.offset, 16);
+    EXPECT_EQ(res.depth, 1);
+    EXPECT_EQ(res.path[0], 0);
+
+    EXPECT_EQ(allocCount, 0);
+}
+
+// ============================================================================
+
+TEST(testParseResult, Limits)
+{
+    allocCount = 0;
+
+    // Nesting one level deeper than allowed
+    OscBundle* bundle = osc_bundle_create(OSC_IMMEDIATE);
+    OscBundle* inner  = bundle;
+    for (int i=1; i<OSC_PARSE_MAX_DEPTH; ++i) {
+        OscBundle* next = osc_bundle_create(OSC_IMMEDIATE);
+        osc_bundle_add_bundle(inner, next);
+        inner = next;
+    }
+
+    OscMessage* msg = osc_message_create("i");
+    msg->addr = osc_strdup("/deep");
+    osc_bundle_add_message(inner, msg);
+
+    uint8_t* data = NULL;
+    size_t   size = 0;
+    EXPECT_EQ(osc_encode_bundle(bundle, &data, &size), 0);
+
+    OscInfo info;
+    EXPECT_EQ(osc_validate(data, size, &info), 0);
+    EXPECT_EQ(info.depth, OSC_PARSE_MAX_DEPTH);
+    osc_bundle_delete(osc_parse(data, size));
+    osc_free(data);
+
+    OscBundle* outer = osc_bundle_create(OSC_IMMEDIATE);
+    osc_bundle_add_bundle(outer, bundle);
+
+    data = NULL;
+    EXPECT_EQ(osc_encode_bundle(outer, &data, &size), 0);
+
+    OscParseResult res;
+    EXPECT_EQ(osc_parse_result(NULL, data, size, OSC_PARSE_LENIENT, &res), nullptr);
+    EXPECT_EQ(res.error, OSC_ERR_LIMIT);
+    EXPECT_EQ(osc_parse_packet(data, size), nullptr);
+    osc_free(data);
+    osc_bundle_delete(outer);
+
+    // Too many elements, 8 byte messages
+    size = 16 + 12 * (OSC_PARSE_MAX_ELEMENTS + 1);
+    data = (uint8_t*)osc_malloc(size);
+    memset(data, 0, size);
+    memcpy(data, "#bundle", 8);
+    for (size_t ptr=16; ptr<size; ptr+=12) {
+        data[ptr + 3] = 8;
+        data[ptr + 4] = '/';
+        data[ptr + 8] = ',';
+    }
+
+    EXPECT_EQ(osc_validate(data, size - 12, NULL), 0);
+    EXPECT_EQ(osc_validate_result(data, size, OSC_PARSE_LENIENT, NULL, &res), -1);
+    EXPECT_EQ(res.error, OSC_ERR_LIMIT);
+    EXPECT_EQ(res.offset, size - 12);
+    EXPECT_EQ(osc_parse(data, size), nullptr);
+    osc_free(data);
+
+    // Oversize packet
+    size = OSC_PARSE_MAX_SIZE + 4;
+    data = (uint8_t*)osc_malloc(size);
+    memset(data, 0, size);
+    memcpy(data, "/big\0\0\0\0,", 9);
+    EXPECT_EQ(osc_validate(data, size - 8, NULL), 0);
+    EXPECT_EQ(osc_validate(data, size, NULL), -1);
+    EXPECT_EQ(osc_parse(data, size), nullptr);
+    osc_free(data);
+
+    // Element sizes are checked by the allocating parser
+    uint8_t truncated[] = {
+        '#', 'b', 'u', 'n', 'd', 'l', 'e', 0,   0, 0, 0, 0, 0, 0, 0, 1,
+        0, 0, 0, 12,  '/', 'a', 0, 0,  ',', 'i', 0, 0,  0, 0, 0, 7,
+        0, 0,
+    };
+    EXPECT_EQ(osc_parse(truncated, sizeof(truncated)), nullptr);
+    truncated[19] = 13;
+    EXPECT_EQ(osc_parse(truncated, 32), nullptr);
+
+    EXPECT_EQ(allocCount, 0);
+}
+
+// ============================================================================
+
+TEST(testParseParallel, Nested)
+{
+    allocCount = 0;
+
+    // 200 sub-bundles of 3 messages, plus top level messages
+    OscBundle* bundle = osc_bundle_create(0x0123456789ABCDEFLL);
+    for (int b=0; b<200; ++b) {
+        OscBundle* inner = osc_bundle_create(OSC_IMMEDIATE + b);
+        for (int m=0; m<3; ++m) {
+            char addr[64];
+            snprintf(addr, sizeof(addr), "/bundle/%d/msg/%d", b, m);
+
+            OscMessage* msg = osc_message_create("isf");
+            msg->addr = osc_strdup(addr);
+            msg->args[0].i32 = b * 3 + m;
+            msg->args[1].str = osc_strdup(addr);
+            msg->args[2].f32 = (float)m;
+            osc_bundle_add_message(inner, msg);
+        }
+        osc_bundle_add_bundle(bundle, inner);
+
+        if (b % 50 == 0) {
+            OscMessage* msg = osc_message_create("i");
+            msg->addr = osc_strdup("/top");
+            msg->args[0].i32 = b;
+            osc_bundle_add_message(bundle, msg);
+        }
+    }
+
+    uint8_t* data = NULL;
+    size_t   size = 0;
+    EXPECT_EQ(osc_encode_bundle(bundle, &data, &size), 0);
+    EXPECT_GT(size, OSC_PARALLEL_MIN_SIZE);
+
+    OscParser* parser = osc_parser_create(3);
+    ASSERT_NE(parser, nullptr);
+
+    // Same tree as the serial parser, compared by encoding
+    OscBundle* serial = osc_parse(data, size);
+    ASSERT_NE(serial, nullptr);
+
+    uint8_t* expected = NULL;
+    size_t   expected_size = 0;
+    EXPECT_EQ(osc_encode_bundle(serial, &expected, &expected_size), 0);
+
+    for (int i=0; i<20; ++i) {
+        OscBundle* parsed = osc_parse_parallel(parser, data, size);
+        ASSERT_NE(parsed, nullptr);
+        EXPECT_EQ(parsed->timestamp, 0x0123456789ABCDEFLL);
+
+        uint8_t* out = NULL;
+        size_t   out_size = 0;
+        EXPECT_EQ(osc_encode_bundle(parsed, &out, &out_size), 0);
+        ASSERT_EQ(out_size, expected_size);
+        EXPECT_EQ(memcmp(out, expected, out_size), 0);
+
+        osc_free(out);
+        osc_bundle_delete(parsed);
+    }
+
+    // Unknown tag in the last sub-bundle
+    uint8_t* copy = (uint8_t*)osc_malloc(size);
+    memcpy(copy, data, size);
+
+    size_t tags = size - 4;
+    while (memcmp(&copy[tags], ",isf", 4)) tags -= 4;
+    copy[tags + 1] = 'x';
+    EXPECT_EQ(osc_parse(copy, size), nullptr);
+    EXPECT_EQ(osc_parse_parallel(parser, copy, size), nullptr);
+
+    // Broken framing and small packets take the serial path
+    copy[19] = 0xFF;
+    EXPECT_EQ(osc_parse_parallel(parser, copy, size), nullptr);
+    osc_free(copy);
+
+    OscBundle* small = osc_parse_parallel(parser, data, 64);
+    EXPECT_EQ(small, nullptr);
+
+    osc_parser_delete(parser);
+
+    // Without workers the caller parses everything
+    parser = osc_parser_create(0);
+    OscBundle* parsed = osc_parse_parallel(parser, data, size);
+    ASSERT_NE(parsed, nullptr);
+    osc_bundle_delete(parsed);
+    osc_parser_delete(parser);
+
+    // Without a parser as well
+    parsed = osc_parse_parallel(NULL, data, size);
+    ASSERT_NE(parsed, nullptr);
+    osc_bundle_delete(parsed);
+
+    osc_free(expected);
+    osc_free(data);
+    osc_bundle_delete(serial);
+    osc_bundle_delete(bundle);
+
+    EXPECT_EQ(allocCount, 0);
+}
+
+// ============================================================================
+
+TEST(testQueue, Spsc)
+{
+    allocCount = 0;
+
+    OscQueue* queue = osc_queue_create(OSC_QUEUE_SPSC, 5);
+    EXPECT_NE(queue, nullptr);
+    EXPECT_EQ(osc_queue_capacity(queue), 8);
+
+    // Fill and empty
+    for (uintptr_t i=1; i<=8; ++i) {
+        EXPECT_EQ(osc_queue_push(queue, (void*)i), 0);
+    }
+    EXPECT_EQ(osc_queue_push(queue, (void*)9), -1);
+    EXPECT_EQ(osc_queue_push(queue, NULL), -1);
+
+    for (uintptr_t i=1; i<=8; ++i) {
+        EXPECT_EQ((uintptr_t)osc_queue_pop(queue), i);
+    }
+    EXPECT_EQ(osc_queue_pop(queue), nullptr);
+
+    // Across threads, in order
+    const uintptr_t count = 100000;
+    uintptr_t       bad   = 0;
+
+    std::thread consumer([&] {
+        for (uintptr_t next = 1; next <= count; ) {
+            void* item = osc_queue_pop(queue);
+            if (!item) { std::this_thread::yield(); continue; }
+            if ((uintptr_t)item != next) bad++;
+            next++;
+        }
+    });
+
+    for (uintptr_t i=1; i<=count; ) {
+        if (osc_queue_push(queue, (void*)i) == 0) i++;
+        else std::this_thread::yield();
+    }
+
+    consumer.join();
+    EXPECT_EQ(bad, 0);
+
+    osc_queue_delete(queue);
+
+    EXPECT_EQ(allocCount, 0);
+}
+
+TEST(testQueue, Mpsc)
+{
+    allocCount = 0;
+
+    OscQueue* queue = osc_queue_create(OSC_QUEUE_MPSC, 64);
+    EXPECT_NE(queue, nullptr);
+
+    // Items carry the producer in the top bits, order is kept per producer
+    const uintptr_t count     = 50000;
+    const size_t    producers = 3;
+
+    std::thread threads[producers];
+    for (size_t p=0; p<producers; ++p) {
+        threads[p] = std::thread([=] {
+            for (uintptr_t i=1; i<=count; ) {
+                if (osc_queue_push(queue, (void*)((p << 24) | i)) == 0) i++;
+                else std::this_thread::yield();
+            }
+        });
+    }
+
+    uintptr_t next[producers] = {1, 1, 1};
+    uintptr_t bad = 0;
+    for (size_t total = 0; total < producers * count; ) {
+        uintptr_t item = (uintptr_t)osc_queue_pop(queue);
+        if (!item) { std::this_thread::yield(); continue; }
+
+        size_t p = item >> 24;
+        if (p >= producers || (item & 0xFFFFFF) != next[p]) bad++;
+        else next[p]++;
+        total++;
+    }
+
+    for (size_t p=0; p<producers; ++p) {
+        threads[p].join();
+    }
+
+    EXPECT_EQ(bad, 0);
+    EXPECT_EQ(osc_queue_pop(queue), nullptr);
+
+    osc_queue_delete(queue);
+
+    EXPECT_EQ(allocCount, 0);
+}
+
+static void release_packet (void* item) {
+    osc_packet_delete((const OscPacket*)item);
+}
+
+TEST(testQueue, ReturnPath)
+{
+    allocCount = 0;
+
+    OscQueue* forward = osc_queue_create(OSC_QUEUE_SPSC, 16);
+    OscQueue* retired = osc_queue_create(OSC_QUEUE_SPSC, 16);
+
+    OscMessage* msg = osc_message_create("i");
+    msg->addr = osc_strdup("/count");
+
+    uint8_t  data[64];
+    size_t   size  = 0;
+    const int32_t count = 1000;
+
+    // The consumer only reads and hands packets back, no frees
+    int32_t sum = 0;
+    std::thread consumer([&] {
+        for (int32_t n = 0; n < count; ) {
+            OscPacket* packet = (OscPacket*)osc_queue_pop(forward);
+            if (!packet) { std::this_thread::yield(); continue; }
+
+            sum += packet->args[0].i32;
+            while (osc_queue_push(retired, packet)) std::this_thread::yield();
+            n++;
+        }
+    });
+
+    // The producer parses, sends and releases what came back
+    size_t released = 0;
+    for (int32_t i=0; i<count; ++i) {
+        msg->args[0].i32 = i;
+        EXPECT_EQ(osc_encode_message_into(msg, data, sizeof(data), &size), 0);
+
+        OscPacket* packet = osc_parse_packet(data, size);
+        while (osc_queue_push(forward, packet)) {
+            released += osc_queue_drain(retired, release_packet);
+            std::this_thread::yield();
+        }
+        released += osc_queue_drain(retired, release_packet);
+    }
+
+    consumer.join();
+    released += osc_queue_drain(retired, release_packet);
+
+    EXPECT_EQ(released, count);
+    EXPECT_EQ(sum, count * (count - 1) / 2);
+
+    osc_message_delete(msg);
+    osc_queue_delete(forward);
+    osc_queue_delete(retired);
+
+    EXPECT_EQ(allocCount, 0);
+}
+
+// ============================================================================
+
+TEST(testPool, CreateDelete)
+{
+    allocCount = 0;
+
+    const size_t counts[OSC_POOL_CLASSES] = {64, 64, 32, 16, 8, 4, 2, 1};
+    OscPool* pool = osc_pool_create(counts);
+    EXPECT_NE(pool, nullptr);
+    EXPECT_EQ(osc_pool_bind(pool), nullptr);
+
+    int32_t allocs = allocCount;
+
+    uint8_t data[256];
+    size_t  size = 0;
+
+    for (int pass=0; pass<10; ++pass) {
+        OscMessage* msg = osc_message_create("ifsT");
+        msg->addr = osc_strdup("/synth/voice/1");
+        msg->args[0].i32 = pass;
+        msg->args[1].f32 = 0.5f;
+        msg->args[2].str = osc_strdup("a string argument");
+
+        OscBundle* bundle = osc_bundle_create(OSC_IMMEDIATE);
+        osc_bundle_add_message(bundle, msg);
+
+        // Strings of osc_strdup() come from the heap and can be replaced
+        EXPECT_EQ(osc_pool_used(pool), 4);
+        osc_free(msg->args[2].str);
+        msg->args[2].str = osc_strdup("a string argument");
+
+        EXPECT_EQ(osc_encode_bundle_into(bundle, data, sizeof(data), &size), 0);
+        osc_bundle_delete(bundle);
+
+        // The parser allocates from the pool as well
+        OscBundle* dec = osc_parse(data, size);
+        EXPECT_NE(dec, nullptr);
+        EXPECT_EQ(dec->messages->args[0].i32, pass);
+        EXPECT_STREQ(dec->messages->args[2].str, "a string argument");
+        osc_bundle_delete(dec);
+
+        EXPECT_EQ(osc_pool_used(pool), 0);
+    }
+
+    EXPECT_EQ(allocCount, allocs);
+    EXPECT_EQ(osc_pool_misses(pool), 0);
+
+    EXPECT_EQ(osc_pool_bind(NULL), pool);
+    osc_pool_delete(pool);
+
+    EXPECT_EQ(allocCount, 0);
+}
+
+TEST(testPool, Exhausted)
+{
+    allocCount = 0;
+
+    // Small blocks spill into larger classes, then to the heap
+    const size_t counts[OSC_POOL_CLASSES] = {1, 1, 0, 0, 0, 0, 0, 0};
+    OscPool* pool = osc_pool_create(counts);
+    osc_pool_bind(pool);
+
+    OscMessage* msg = osc_message_create("i");
+    msg->addr = osc_strdup("/a");
+
+    EXPECT_EQ(osc_pool_used(pool), 2);
+    EXPECT_EQ(osc_pool_misses(pool), 1);
+
+    osc_message_delete(msg);
+    EXPECT_EQ(osc_pool_used(pool), 0);
+
+    osc_pool_delete(pool);
+    EXPECT_EQ(osc_pool_bind(NULL), nullptr);
+
+    EXPECT_EQ(allocCount, 0);
+}
+
+// ============================================================================
+
+TEST(testStats, Counters)
+{
+    allocCount = 0;
+
+    OscStats before, after;
+    EXPECT_EQ(osc_stats_thread(&before), 0);
+
+    OscMessage* msg = osc_message_create("if");
+    msg->addr = osc_strdup("/stats");
+
+    uint8_t* data = NULL;
+    size_t   size = 0;
+    EXPECT_EQ(osc_encode_message(msg, &data, &size), 0);
+
+    OscBundle* dec = osc_parse(data, size);
+    EXPECT_NE(dec, nullptr);
+    osc_bundle_delete(dec);
+
+    // Rejects by reason
+    EXPECT_EQ(osc_parse(data, size - 4), nullptr);
+    EXPECT_EQ(osc_validate((const uint8_t*)"x", 1, NULL), -1);
+
+    EXPECT_EQ(osc_stats_thread(&after), 0);
+    EXPECT_EQ(after.packets_parsed  - before.packets_parsed, 1);
+    EXPECT_EQ(after.packets_encoded - before.packets_encoded, 1);
+    EXPECT_EQ(after.bytes_in  - before.bytes_in, size);
+    EXPECT_EQ(after.bytes_out - before.bytes_out, size);
+    EXPECT_EQ(after.rejects[OSC_ERR_ARGUMENT] - before.rejects[OSC_ERR_ARGUMENT], 1);
+    EXPECT_EQ(after.rejects[OSC_ERR_ADDRESS]  - before.rejects[OSC_ERR_ADDRESS], 1);
+    EXPECT_GE(after.allocs - before.allocs, 5);
+    EXPECT_GT(after.parse_cycles, before.parse_cycles);
+    EXPECT_GT(after.parse_cycles_max, 0);
+
+    // Large packets count the heap scratch besides the result
+    static uint8_t wave[3 * 4096];
+    OscMessage* big = osc_message_create("b");
+    big->addr = osc_strdup("/wave");
+    big->args[0].blob.data = wave;
+    big->args[0].blob.size = sizeof(wave);
+
+    uint8_t* big_data = NULL;
+    size_t   big_size = 0;
+    EXPECT_EQ(osc_stats_thread(&before), 0);
+    EXPECT_EQ(osc_encode_message(big, &big_data, &big_size), 0);
+    EXPECT_EQ(osc_stats_thread(&after), 0);
+    EXPECT_GE(after.allocs - before.allocs, 2);
+    EXPECT_GE(after.alloc_bytes - before.alloc_bytes, 2 * big_size);
+
+    osc_free(big_data);
+    osc_message_delete(big);
+
+    // Exited threads are kept in the totals
+    std::thread worker([&] {
+        uint8_t buf[64];
+        size_t  written = 0;
+        osc_encode_message_into(msg, buf, sizeof(buf), &written);
+    });
+    worker.join();
+
+    OscStats total;
+    EXPECT_EQ(osc_stats_snapshot(&total), 0);
+    EXPECT_GE(total.packets_encoded, after.packets_encoded + 1);
+
+    osc_free(data);
+    osc_message_delete(msg);
+
+    EXPECT_EQ(allocCount, 0);
+}
@@ -0,0 +1,428 @@
+#include "osc.h"
+#include "osc_net.h"
+#include "router.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+// ============================================================================
+// OSC router. Receives packets on UDP and / or TCP and forwards them over
+// UDP by address pattern rules:
+//
+//   oscrouter -u 9000 -t 9000 -r /mixer@10.0.0.2:9000 -r /light=/dmx@10.0.0.3:7000
+//
+// A rule PATTERN[=PREFIX]@HOST:PORT matches messages whose leading address
+// segments match PATTERN (OSC pattern syntax, "/" matches everything) and
+// replaces those segments by PREFIX when given. Packets entirely routed to
+// a destination without rewriting are forwarded byte for byte, otherwise
+// bundles are rebuilt from the routed elements.
+//
+// Every worker thread owns SO_REUSEPORT sockets so the kernel spreads
+// datagrams and connections across them.
+
+#define ROUTER_MAX_CONNS    64      // TCP connections per worker
+#define ROUTER_BATCH        32      // Datagrams per recvmmsg()
+#define ROUTER_MTU          65536   // Max packet size
+
+// ============================================================================
+
+typedef struct _RouterConfig {
+
+    RouterTable table;
+
+    OscNetAddr  dests [ROUTER_MAX_RULES];
+    size_t      num_dests;
+
+    int         udp_port;   // 0 when disabled
+    int         tcp_port;   // 0 when disabled
+    int         framing;    // TCP stream framing
+    size_t      threads;
+
+} RouterConfig;
+
+typedef struct _RouterWorker {
+
+    const RouterConfig* cfg;
+    pthread_t           thread;
+
+    int                 udp;    // UDP socket, -1 if none
+    int                 tcp;    // TCP listener, -1 if none
+    int                 out;    // Sending socket, the UDP one when open, -1 if none
+
+    OscNetRx*           rx;
+    OscNetTx*           tx;
+    uint8_t*            scratch;    // Rebuilt packets
+
+    int                 conns [ROUTER_MAX_CONNS];
+    OscStreamDecoder*   decs  [ROUTER_MAX_CONNS];
+    size_t              num_conns;
+
+    size_t              received;
+    size_t              dropped;
+
+} RouterWorker;
+
+static volatile sig_atomic_t router_stop = 0;
+
+// ============================================================================
+
+// Routes a packet received on any transport
+static void router_route (RouterWorker* w, const uint8_t* data, size_t size) {
+
+    const RouterConfig* cfg = w->cfg;
+
+    w->received++;
+
+    uint64_t forward = 0;
+    uint64_t rebuild = 0;
+    if (router_table_route(&cfg->table, data, size, &forward, &rebuild)) {
+        w->dropped++;
+        return;
+    }
+
+    // Destinations of the original bytes, copied by the sender when queued
+    OscNetAddr targets [ROUTER_MAX_RULES];
+    size_t     count = 0;
+
+    for (size_t d=0; d<cfg->num_dests; ++d) {
+        uint64_t bit = 1ULL << d;
+
+        if (forward & bit) {
+            targets[count++] = cfg->dests[d];
+        }
+        else if (rebuild & bit) {
+            size_t len = router_table_build(&cfg->table, d, data, size, w->scratch, ROUTER_MTU);
+            if (len) {
+                osc_net_tx_queue(w->tx, w->scratch, len, &cfg->dests[d], 1);
+            }
+        }
+    }
+
+    if (count) {
+        osc_net_tx_queue(w->tx, data, size, targets, count);
+    }
+}
+
+static void router_packet (const uint8_t* data, size_t size, void* user) {
+    router_route((RouterWorker*)user, data, size);
+}
+
+// ============================================================================
+
+static void router_close (RouterWorker* w, size_t index) {
+
+    close(w->conns[index]);
+    osc_stream_decoder_delete(w->decs[index]);
+
+    w->num_conns--;
+    w->conns[index] = w->conns[w->num_conns];
+    w->decs [index] = w->decs [w->num_conns];
+}
+
+static void* router_run (void* arg) {
+
+    RouterWorker*       w   = (RouterWorker*)arg;
+    const RouterConfig* cfg = w->cfg;
+
+    struct pollfd fds [2 + ROUTER_MAX_CONNS];
+    uint8_t*      buf = (uint8_t*)osc_malloc(ROUTER_MTU);
+
+    while (!router_stop) {
+
+        // Sockets first, then connections in index order
+        size_t nfds = 0;
+        fds[nfds].fd = w->udp; fds[nfds++].events = POLLIN;
+        fds[nfds].fd = w->tcp; fds[nfds++].events = POLLIN;
+        for (size_t i=0; i<w->num_conns; ++i) {
+            fds[nfds].fd = w->conns[i]; fds[nfds++].events = POLLIN;
+        }
+
+        if (poll(fds, nfds, 100) < 0 && errno != EINTR) {
+            break;
+        }
+
+        // Datagrams, drain the socket
+        if (w->udp >= 0 && (fds[0].revents & POLLIN)) {
+            int res;
+            while ((res = osc_net_rx_recv(w->rx, NULL, NULL, ROUTER_BATCH, MSG_DONTWAIT)) > 0) {
+                for (size_t i=0; i<(size_t)res; ++i) {
+                    size_t         size = 0;
+                    const uint8_t* data = osc_net_rx_data(w->rx, i, &size);
+                    router_route(w, data, size);
+                }
+                osc_net_tx_flush(w->tx);
+            }
+        }
+
+        // Stream data. Closed connections are swapped with the last one,
+        // walk backwards so poll results keep lining up.
+        for (size_t i=w->num_conns; i-- > 0; ) {
+            if (!(fds[2 + i].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+
+            ssize_t len = read(w->conns[i], buf, ROUTER_MTU);
+            if (len < 0 && (errno == EAGAIN || errno == EINTR)) continue;
+            if (len <= 0) {
+                router_close(w, i);
+                continue;
+            }
+
+            if (osc_stream_decode(w->decs[i], buf, (size_t)len, router_packet, w) < 0) {
+                w->dropped++;
+            }
+        }
+
+        osc_net_tx_flush(w->tx);
+
+        // New connections
+        if (w->tcp >= 0 && (fds[1].revents & POLLIN)) {
+            int fd = accept4(w->tcp, NULL, NULL, SOCK_NONBLOCK);
+            if (fd >= 0) {
+                OscStreamDecoder* dec = NULL;
+                if (w->num_conns < ROUTER_MAX_CONNS) {
+                    dec = osc_stream_decoder_create(cfg->framing, ROUTER_MTU);
+                }
+
+                if (dec) {
+                    w->conns[w->num_conns] = fd;
+                    w->decs [w->num_conns] = dec;
+                    w->num_conns++;
+                }
+                else {
+                    close(fd);
+                }
+            }
+        }
+    }
+
+    while (w->num_conns) {
+        router_close(w, 0);
+    }
+
+    osc_free((void*)buf);
+    return NULL;
+}
+
+// ============================================================================
+
+static int router_listen (int type, int port) {
+
+    int fd = socket(AF_INET, type | SOCK_NONBLOCK, 0);
+    if (fd < 0) {
+        return -1;
+    }
+
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one))) {
+        close(fd);
+        return -1;
+    }
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_port        = htons((uint16_t)port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) ||
+        (type == SOCK_STREAM && listen(fd, 64))) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+// Parses HOST:PORT into a destination, reusing an equal one
+static int router_dest (RouterConfig* cfg, const char* spec, size_t* pindex) {
+
+    char host[256];
+    const char* colon = strrchr(spec, ':');
+    if (!colon || (size_t)(colon - spec) >= sizeof(host)) {
+        return -1;
+    }
+
+    memcpy(host, spec, (size_t)(colon - spec));
+    host[colon - spec] = 0;
+
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family   = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+
+    struct addrinfo* res = NULL;
+    if (getaddrinfo(host, colon + 1, &hints, &res) || !res) {
+        return -1;
+    }
+
+    OscNetAddr dest;
+    memset(&dest, 0, sizeof(dest));
+    memcpy(&dest.addr, res->ai_addr, res->ai_addrlen);
+    dest.len = res->ai_addrlen;
+    freeaddrinfo(res);
+
+    for (size_t i=0; i<cfg->num_dests; ++i) {
+        if (cfg->dests[i].len == dest.len && !memcmp(&cfg->dests[i].addr, &dest.addr, dest.len)) {
+            *pindex = i;
+            return 0;
+        }
+    }
+
+    if (cfg->num_dests >= ROUTER_MAX_RULES) {
+        return -1;
+    }
+
+    *pindex = cfg->num_dests;
+    cfg->dests[cfg->num_dests++] = dest;
+    return 0;
+}
+
+// Parses PATTERN[=PREFIX]@HOST:PORT, modifies the string in place
+static int router_rule (RouterConfig* cfg, char* spec) {
+
+    char* at = strrchr(spec, '@');
+    if (!at) {
+        return -1;
+    }
+    *at = 0;
+
+    size_t dest = 0;
+    if (router_dest(cfg, at + 1, &dest)) {
+        return -1;
+    }
+
+    return router_table_add(&cfg->table, spec, dest);
+}
+
+static void router_signal (int sig) {
+    (void)sig;
+    router_stop = 1;
+}
+
+static void router_usage (const char* name) {
+    fprintf(stderr,
+        "usage: %s [-u port] [-t port] [-s] [-j threads] -r rule...\n"
+        "  -u port     UDP port to listen on\n"
+        "  -t port     TCP port to listen on\n"
+        "  -s          SLIP framing on TCP (default: size prefix)\n"
+        "  -j threads  worker threads (default: one per CPU)\n"
+        "  -r rule     PATTERN[=PREFIX]@HOST:PORT\n", name);
+}
+
+// ============================================================================
+
+int main (int argc, char* argv[]) {
+
+    RouterConfig cfg;
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.framing = OSC_STREAM_LENGTH;
+
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    cfg.threads = cpus > 0 ? (size_t)cpus : 1;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "u:t:sj:r:h")) != -1) {
+        switch (opt) {
+            case 'u': cfg.udp_port = atoi(optarg);           break;
+            case 't': cfg.tcp_port = atoi(optarg);           break;
+            case 's': cfg.framing  = OSC_STREAM_SLIP;        break;
+            case 'j': cfg.threads  = (size_t)atoi(optarg);   break;
+
+            case 'r':
+                if (router_rule(&cfg, optarg)) {
+                    fprintf(stderr, "invalid rule '%s'\n", optarg);
+                    return 1;
+                }
+                break;
+
+            default:
+                router_usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    if ((!cfg.udp_port && !cfg.tcp_port) || !cfg.table.num_rules || !cfg.threads) {
+        router_usage(argv[0]);
+        return 1;
+    }
+
+    signal(SIGINT,  router_signal);
+    signal(SIGTERM, router_signal);
+    signal(SIGPIPE, SIG_IGN);
+
+    // Sockets are all opened before any worker starts
+    RouterWorker* workers = (RouterWorker*)osc_malloc(cfg.threads * sizeof(RouterWorker));
+    memset((void*)workers, 0, cfg.threads * sizeof(RouterWorker));
+
+    // Cleanup only closes descriptors that were opened
+    for (size_t i=0; i<cfg.threads; ++i) {
+        workers[i].udp = -1;
+        workers[i].tcp = -1;
+        workers[i].out = -1;
+    }
+
+    int err = 0;
+    for (size_t i=0; i<cfg.threads && !err; ++i) {
+        RouterWorker* w = &workers[i];
+        w->cfg = &cfg;
+        w->udp = cfg.udp_port ? router_listen(SOCK_DGRAM,  cfg.udp_port) : -1;
+        w->tcp = cfg.tcp_port ? router_listen(SOCK_STREAM, cfg.tcp_port) : -1;
+
+        // Sends go out of the UDP socket when there is one
+        w->out = w->udp >= 0 ? w->udp : socket(AF_INET, SOCK_DGRAM, 0);
+
+        w->rx      = w->udp >= 0 ? osc_net_rx_create(w->udp, ROUTER_BATCH, ROUTER_MTU) : NULL;
+        w->tx      = osc_net_tx_create(w->out, ROUTER_BATCH, ROUTER_MTU, ROUTER_BATCH * 4);
+        w->scratch = (uint8_t*)osc_malloc(ROUTER_MTU);
+
+        if ((cfg.udp_port && (w->udp < 0 || !w->rx)) || (cfg.tcp_port && w->tcp < 0) ||
+            !w->tx || !w->scratch) {
+            fprintf(stderr, "failed to set up worker %zu: %s\n", i, strerror(errno));
+            err = 1;
+        }
+    }
+
+    if (!err) {
+        for (size_t i=0; i<cfg.threads; ++i) {
+            pthread_create(&workers[i].thread, NULL, router_run, &workers[i]);
+        }
+
+        for (size_t i=0; i<cfg.threads; ++i) {
+            pthread_join(workers[i].thread, NULL);
+        }
+    }
+
+    size_t received = 0;
+    size_t dropped  = 0;
+
+    for (size_t i=0; i<cfg.threads; ++i) {
+        RouterWorker* w = &workers[i];
+        received += w->received;
+        dropped  += w->dropped;
+
+        if (w->tx) {
+            osc_net_tx_flush(w->tx);
+            osc_net_tx_delete(w->tx);
+        }
+
+        osc_net_rx_delete(w->rx);
+        if (w->scratch) osc_free((void*)w->scratch);
+
+        if (w->out >= 0 && w->out != w->udp) close(w->out);
+        if (w->udp >= 0) close(w->udp);
+        if (w->tcp >= 0) close(w->tcp);
+    }
+
+    osc_free((void*)workers);
+
+    fprintf(stderr, "%zu packets received, %zu dropped\n", received, dropped);
+    return err;
+}
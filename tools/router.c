@@ -0,0 +1,231 @@
+#include "router.h"
+
+#include <string.h>
+
+// ============================================================================
+
+static const uint8_t router_magic[] = {'#', 'b', 'u', 'n', 'd', 'l', 'e', 0};
+
+static int router_is_bundle (const uint8_t* data, size_t size) {
+    return size >= 16 && !memcmp(data, router_magic, sizeof(router_magic));
+}
+
+static size_t router_read32 (const uint8_t* p) {
+    return ((size_t)p[0] << 24) | ((size_t)p[1] << 16) |
+           ((size_t)p[2] <<  8) |  (size_t)p[3];
+}
+
+static void router_write32 (uint8_t* p, size_t v) {
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >>  8);
+    p[3] = (uint8_t)(v);
+}
+
+// Number of segments of an address ("/" has none)
+static size_t router_segments (const char* addr) {
+
+    size_t count = 0;
+    for (const char* p = addr; *p; ++p) {
+        if (*p == '/' && p[1]) count++;
+    }
+
+    return count;
+}
+
+// ============================================================================
+
+int router_table_add (RouterTable* table, char* spec, size_t dest) {
+
+    if (table->num_rules >= ROUTER_MAX_RULES || dest >= ROUTER_MAX_RULES || spec[0] != '/') {
+        return -1;
+    }
+
+    RouterRule* rule = &table->rules[table->num_rules];
+    rule->pattern = spec;
+    rule->rewrite = NULL;
+    rule->dest    = dest;
+
+    char* eq = strchr(spec, '=');
+    if (eq) {
+        *eq = 0;
+        rule->rewrite = eq + 1;
+        if (rule->rewrite[0] != '/') return -1;
+    }
+
+    // Trailing slashes do not add segments
+    size_t len = strlen(spec);
+    while (len > 1 && spec[len - 1] == '/') spec[--len] = 0;
+    rule->segments = router_segments(spec);
+
+    table->num_rules++;
+    return 0;
+}
+
+long router_rule_match (const RouterRule* rule, const char* addr) {
+
+    if (rule->segments == 0) {
+        return 0;
+    }
+
+    // End of the leading segments
+    size_t end = 0;
+    for (size_t i=0; i<rule->segments; ++i) {
+        if (addr[end] != '/') return -1;
+        for (end++; addr[end] && addr[end] != '/'; ++end);
+    }
+
+    if (end >= ROUTER_MAX_ADDR) {
+        return -1;
+    }
+
+    char prefix[ROUTER_MAX_ADDR];
+    memcpy(prefix, addr, end);
+    prefix[end] = 0;
+
+    return osc_pattern_match(rule->pattern, prefix) ? (long)end : -1;
+}
+
+// First rule of dest matching addr, NULL if none
+static const RouterRule* router_find (const RouterTable* table, const char* addr,
+                                      size_t dest, long* pend) {
+
+    for (size_t i=0; i<table->num_rules; ++i) {
+        const RouterRule* rule = &table->rules[i];
+        if (rule->dest != dest) continue;
+
+        long end = router_rule_match(rule, addr);
+        if (end >= 0) {
+            *pend = end;
+            return rule;
+        }
+    }
+
+    return NULL;
+}
+
+// ============================================================================
+
+// Accumulates the destinations of every message of a validated packet: those
+// receiving all of them, any of them and those needing an address rewrite
+static void router_scan (const RouterTable* table, const uint8_t* data, size_t size,
+                         uint64_t* pall, uint64_t* pany, uint64_t* prewrite) {
+
+    if (router_is_bundle(data, size)) {
+        for (size_t ptr = 16; ptr < size; ) {
+            size_t len = router_read32(&data[ptr]);
+            router_scan(table, &data[ptr + 4], len, pall, pany, prewrite);
+            ptr += 4 + len;
+        }
+        return;
+    }
+
+    const char* addr = (const char*)data;
+    uint64_t    mask = 0;
+
+    // First matching rule per destination decides
+    for (size_t i=0; i<table->num_rules; ++i) {
+        const RouterRule* rule = &table->rules[i];
+        uint64_t          bit  = 1ULL << rule->dest;
+
+        if (mask & bit) continue;
+        if (router_rule_match(rule, addr) < 0) continue;
+
+        mask |= bit;
+        if (rule->rewrite) *prewrite |= bit;
+    }
+
+    *pall &= mask;
+    *pany |= mask;
+}
+
+int router_table_route (const RouterTable* table, const uint8_t* data, size_t size,
+                        uint64_t* pforward, uint64_t* prebuild) {
+
+    *pforward = 0;
+    *prebuild = 0;
+
+    if (osc_validate(data, size, NULL)) {
+        return -1;
+    }
+
+    uint64_t all     = ~0ULL;
+    uint64_t any     = 0;
+    uint64_t rewrite = 0;
+    router_scan(table, data, size, &all, &any, &rewrite);
+
+    // Untouched to every destination taking the whole packet at once
+    *pforward = any & all & ~rewrite;
+    *prebuild = any & ~*pforward;
+
+    return 0;
+}
+
+size_t router_table_build (const RouterTable* table, size_t dest,
+                           const uint8_t* data, size_t size,
+                           uint8_t* out, size_t cap) {
+
+    // Bundle, empty ones are dropped
+    if (router_is_bundle(data, size)) {
+        if (cap < 16) return 0;
+        memcpy(out, data, 16);
+
+        size_t len = 16;
+        for (size_t ptr = 16; ptr < size; ) {
+            size_t elem = router_read32(&data[ptr]);
+
+            if (cap - len >= 4) {
+                size_t res = router_table_build(table, dest, &data[ptr + 4], elem,
+                                                &out[len + 4], cap - len - 4);
+                if (res) {
+                    router_write32(&out[len], res);
+                    len += 4 + res;
+                }
+            }
+
+            ptr += 4 + elem;
+        }
+
+        return len > 16 ? len : 0;
+    }
+
+    // Message
+    const char* addr = (const char*)data;
+    long        end  = 0;
+
+    const RouterRule* rule = router_find(table, addr, dest, &end);
+    if (!rule) {
+        return 0;
+    }
+
+    if (!rule->rewrite) {
+        if (size > cap) return 0;
+        memcpy(out, data, size);
+        return size;
+    }
+
+    // New address, then the original tags and arguments
+    size_t prefix = strlen(rule->rewrite);
+    size_t rest   = strlen(&addr[end]);
+    size_t tags   = (strlen(addr) + 4) & ~(size_t)3;
+
+    if (prefix && rule->rewrite[prefix - 1] == '/') prefix--;
+
+    size_t addr_len = prefix + rest;
+    size_t addr_pad = addr_len ? (addr_len + 4) & ~(size_t)3 : 4;
+    if (addr_pad + (size - tags) > cap) {
+        return 0;
+    }
+
+    memset(out, 0, addr_pad);
+    if (addr_len) {
+        memcpy(out, rule->rewrite, prefix);
+        memcpy(&out[prefix], &addr[end], rest);
+    }
+    else {
+        out[0] = '/';
+    }
+
+    memcpy(&out[addr_pad], &data[tags], size - tags);
+    return addr_pad + (size - tags);
+}
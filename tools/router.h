@@ -0,0 +1,51 @@
+#ifndef ROUTER_H
+#define ROUTER_H
+
+#include "osc.h"
+
+// ============================================================================
+// oscrouter forwarding rules. A rule PATTERN[=PREFIX] matches messages whose
+// leading address segments match PATTERN (OSC pattern syntax, "/" matches
+// everything) and replaces those segments by PREFIX when given.
+
+#define ROUTER_MAX_RULES    64      // Also the max destination count
+#define ROUTER_MAX_ADDR     1024    // Longest matched address prefix
+
+typedef struct _RouterRule {
+
+    const char* pattern;    // Address pattern
+    size_t      segments;   // Pattern segment count
+    const char* rewrite;    // Replacement prefix, NULL to keep the address
+    size_t      dest;       // Destination index
+
+} RouterRule;
+
+typedef struct _RouterTable {
+
+    RouterRule  rules [ROUTER_MAX_RULES];
+    size_t      num_rules;
+
+} RouterTable;
+
+// Adds PATTERN[=PREFIX] routed to dest, the spec is modified in place and
+// must outlive the table
+int router_table_add (RouterTable* table, char* spec, size_t dest);
+
+// Length of the address prefix matched by the rule, -1 if none
+long router_rule_match (const RouterRule* rule, const char* addr);
+
+// Destination masks of a packet: those receiving the original bytes and
+// those receiving a rebuilt packet. Returns -1 when the packet is malformed.
+int router_table_route (const RouterTable* table, const uint8_t* data, size_t size,
+                        uint64_t* pforward, uint64_t* prebuild);
+
+// Copies the elements of a valid packet routed to dest into out, rewriting
+// addresses. Empty bundles are dropped. Returns the size written, 0 if
+// nothing is routed or it does not fit.
+size_t router_table_build (const RouterTable* table, size_t dest,
+                           const uint8_t* data, size_t size,
+                           uint8_t* out, size_t cap);
+
+// ============================================================================
+
+#endif // ROUTER_H